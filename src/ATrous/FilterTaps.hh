@@ -0,0 +1,120 @@
+// -----------------------------------------------------------------------
+// FilterTaps.hh: Compile-time descriptions of the wavelet filters, for
+//                use by the convolution kernels of the reconstructions.
+// -----------------------------------------------------------------------
+// Copyright (C) 2006, Matthew Whiting, ATNF
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or (at your
+// option) any later version.
+//
+// Duchamp is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Duchamp; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA
+//
+// Correspondence concerning Duchamp may be directed to:
+//    Internet email: Matthew.Whiting [at] atnf.csiro.au
+//    Postal address: Dr. Matthew Whiting
+//                    Australia Telescope National Facility, CSIRO
+//                    PO Box 76
+//                    Epping NSW 1710
+//                    AUSTRALIA
+// -----------------------------------------------------------------------
+#ifndef FILTER_TAPS_H
+#define FILTER_TAPS_H
+
+#include <vector>
+#include <duchamp/ATrous/filter.hh>
+
+namespace duchamp
+{
+
+    /// @brief The taps of a filter, as seen by the convolution kernels.
+    /// @details The convolution kernels of the reconstructions are
+    /// templates, taking one of the classes below as their
+    /// parameter. Each provides width() and coeff(i). For the
+    /// standard filters these are static and return constants, so
+    /// the compiler knows the number of taps and their values, and
+    /// can unroll the loops over the taps and drop the taps that are
+    /// zero. RuntimeTaps reads the values from a Filter, and is used
+    /// for anything else.
+    ///
+    /// All take a Filter in their constructor, so that the kernels
+    /// can create them in the same way.
+
+    class RuntimeTaps
+    {
+    public:
+	RuntimeTaps(Filter &filter){
+	    for(size_t i=0;i<filter.width();i++) coeffs.push_back(filter.coeff(i));
+	};
+	int    width() const {return int(coeffs.size());};
+	double coeff(int i) const {return coeffs[i];};
+    private:
+	std::vector<double> coeffs;
+    };
+
+    /// @brief The B3-spline filter: (1/16, 1/4, 3/8, 1/4, 1/16).
+    class B3SplineTaps
+    {
+    public:
+	B3SplineTaps(Filter &){};
+	static int    width(){return 5;};
+	static double coeff(int i){
+	    return (i==2) ? 0.375 : ((i==1 || i==3) ? 0.25 : 0.0625);
+	};
+    };
+
+    /// @brief The triangle filter: (1/4, 1/2, 1/4).
+    class TriangleTaps
+    {
+    public:
+	TriangleTaps(Filter &){};
+	static int    width(){return 3;};
+	static double coeff(int i){return (i==1) ? 0.5 : 0.25;};
+    };
+
+    /// @brief The Haar filter: (0, 1/2, 1/2).
+    class HaarTaps
+    {
+    public:
+	HaarTaps(Filter &){};
+	static int    width(){return 3;};
+	static double coeff(int i){return (i==0) ? 0. : 0.5;};
+    };
+
+    /// @brief The number of entries in the kernel dispatch tables.
+    const int numFilterTaps = 4;
+
+    /// @brief Does a filter have the same taps as one of the compile-time descriptions?
+    template <class Taps> bool tapsMatch(Filter &filter)
+    {
+	if(int(filter.width()) != Taps::width()) return false;
+	for(int i=0;i<Taps::width();i++)
+	    if(filter.coeff(i) != Taps::coeff(i)) return false;
+	return true;
+    }
+
+    /// @brief Which entry of a kernel dispatch table to use for a filter.
+    inline int filterTapsIndex(Filter &filter)
+    {
+	/// The dispatch tables list the kernels for RuntimeTaps,
+	/// B3SplineTaps, TriangleTaps and HaarTaps, in that order. A
+	/// filter is matched on its coefficients rather than its type,
+	/// so a filter that has been changed with setCoeff() falls back
+	/// to RuntimeTaps.
+	if(tapsMatch<B3SplineTaps>(filter)) return 1;
+	if(tapsMatch<TriangleTaps>(filter)) return 2;
+	if(tapsMatch<HaarTaps>(filter))     return 3;
+	return 0;
+    }
+
+}
+
+#endif
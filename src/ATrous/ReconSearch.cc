@@ -29,10 +29,12 @@
 #include <iostream>
 #include <iomanip>
 #include <vector>
+#include <algorithm>
 #include <duchamp/duchamp.hh>
 #include <duchamp/PixelMap/Object3D.hh>
 #include <duchamp/Cubes/cubes.hh>
 #include <duchamp/Detection/detection.hh>
+#include <duchamp/Detection/DetectionGrid.hh>
 #include <duchamp/ATrous/atrous.hh>
 #include <duchamp/Utils/utils.hh>
 #include <duchamp/Utils/feedback.hh>
@@ -129,6 +131,14 @@ namespace duchamp
   {
     /// This reconstructs a cube by performing a 1D a trous reconstruction
     ///  in the spectrum of each spatial pixel.
+    ///
+    /// The spectra are reconstructed in batches of atrousBatchSize
+    ///  adjacent pixels with atrous1DReconstructBatch(), so that
+    ///  each channel of a batch is read from the cube as a single
+    ///  contiguous run. The batches are independent, so they are
+    ///  shared out between par.getNumThreads() threads. The result
+    ///  is the same as reconstructing each spectrum individually,
+    ///  and does not depend on the number of threads.
 
     size_t xySize = this->axisDim[0] * this->axisDim[1];
 
@@ -136,27 +146,41 @@ namespace duchamp
 
     ProgressBar bar;
     if(!this->reconExists){
-      if(this->par.isVerbose()){
+
+      // Check the maximum scale here, once, rather than for every spectrum.
+      unsigned int numScales = this->par.filter().getNumScales(zdim);
+      if((this->par.getMaxScale()==0)||(this->par.getMaxScale()>numScales)){
+	if(this->par.getMaxScale()!=0)
+	  DUCHAMPWARN("Reading parameters","The requested value of the parameter scaleMax, \"" << this->par.getMaxScale() << "\" is outside the allowed range (1-"<< numScales <<") -- setting to " << numScales);
+	this->par.setMaxScale(numScales);
+      }
+
+      bool verboseFlag = this->par.isVerbose();
+      if(verboseFlag){
 	std::cout<<"  Reconstructing... ";
 	bar.init(xySize);
       }
-      for(size_t npix=0; npix<xySize; npix++){
-
-	if( this->par.isVerbose() ) bar.update(npix+1);
-
-	float *spec = new float[zdim];
-	float *newSpec = new float[zdim];
-	for(size_t z=0;z<zdim;z++) spec[z] = this->array[z*xySize + npix];
-	bool verboseFlag = this->par.isVerbose();
-	this->par.setVerbosity(false);
-	atrous1DReconstruct(zdim,spec,newSpec,this->par);
-	this->par.setVerbosity(verboseFlag);
-	for(size_t z=0;z<zdim;z++) this->recon[z*xySize+npix] = newSpec[z];
-	delete [] spec;
-	delete [] newSpec;
+      long numBatches = (xySize + atrousBatchSize - 1) / atrousBatchSize;
+      size_t numDone = 0;
+
+#pragma omp parallel for schedule(dynamic) num_threads(this->par.getNumThreads())
+      for(long batch=0; batch<numBatches; batch++){
+
+	size_t npix = batch * atrousBatchSize;
+	size_t numSpec = std::min(atrousBatchSize, xySize-npix);
+	atrous1DReconstructBatch(zdim,numSpec,xySize,this->array+npix,this->recon+npix,this->par);
+
+	if(verboseFlag){
+#pragma omp critical (reconProgress)
+	  {
+	    numDone += numSpec;
+	    bar.update(numDone);
+	  }
+	}
       }
+
       this->reconExists = true;
-      if(this->par.isVerbose()){
+      if(verboseFlag){
 	bar.fillSpace(" All Done.");
 	printSpace(std::cout,26);
 	std::cout << "\n";
@@ -170,6 +194,13 @@ namespace duchamp
   {
     /// This reconstructs a cube by performing a 2D a trous reconstruction
     ///  in each spatial image (ie. each channel map) of the cube.
+    ///
+    /// The channels are independent, so they are shared out between
+    ///  par.getNumThreads() threads. Each thread allocates its work
+    ///  arrays once and re-uses them for every channel it does, and
+    ///  the channel maps are reconstructed directly from the array
+    ///  into the recon array. The result does not depend on the
+    ///  number of threads.
 
     size_t xySize = this->axisDim[0] * this->axisDim[1];
     ProgressBar bar;
@@ -177,33 +208,50 @@ namespace duchamp
     size_t xdim=this->axisDim[0],ydim=this->axisDim[1];
 
     if(!this->reconExists){
-      if(this->par.isVerbose()) std::cout<<"  Reconstructing... ";
-      if(useBar&&this->par.isVerbose()) bar.init(this->axisDim[2]);
-      for(size_t z=0;z<this->axisDim[2];z++){
-
-	if( this->par.isVerbose() && useBar ) bar.update((z+1));
-
-	if(!this->par.isFlaggedChannel(z)){
-	  float *im = new float[xySize];
-	  float *newIm = new float[xySize];
-	  for(size_t npix=0; npix<xySize; npix++) 
-	    im[npix] = this->array[z*xySize+npix];
-	  bool verboseFlag = this->par.isVerbose();
-	  this->par.setVerbosity(false);
-	  atrous2DReconstruct(xdim,ydim,im,newIm,this->par);
-	  this->par.setVerbosity(verboseFlag);
-	  for(size_t npix=0; npix<xySize; npix++) 
-	    this->recon[z*xySize+npix] = newIm[npix];
-	  delete [] im;
-	  delete [] newIm;
-	}
-	else {
-	  for(size_t i=z*xySize; i<(z+1)*xySize; i++) 
-	    this->recon[i] = this->array[i];
+
+      // Check the maximum scale here, once, rather than for every channel.
+      unsigned int numScales = this->par.filter().getNumScales(std::min(xdim,ydim));
+      if((this->par.getMaxScale()==0)||(this->par.getMaxScale()>numScales)){
+	if(this->par.getMaxScale()!=0)
+	  DUCHAMPWARN("Reading parameters","The requested value of the parameter scaleMax, \"" << this->par.getMaxScale() << "\" is outside the allowed range (1-"<< numScales <<") -- setting to " << numScales);
+	this->par.setMaxScale(numScales);
+      }
+
+      bool verboseFlag = this->par.isVerbose();
+      if(verboseFlag) std::cout<<"  Reconstructing... ";
+      if(useBar&&verboseFlag) bar.init(this->axisDim[2]);
+      size_t numDone = 0;
+
+#pragma omp parallel num_threads(this->par.getNumThreads())
+      {
+	float *coeffs = new float[xySize];
+	float *wavelet = new float[xySize];
+	std::vector<bool> isGood(xySize);
+
+#pragma omp for schedule(dynamic)
+	for(long z=0;z<long(this->axisDim[2]);z++){
+
+	  if(!this->par.isFlaggedChannel(z)){
+	    atrous2DReconstruct(xdim,ydim,this->array+z*xySize,this->recon+z*xySize,
+				this->par,coeffs,wavelet,isGood,false);
+	  }
+	  else {
+	    for(size_t i=z*xySize; i<(z+1)*xySize; i++) 
+	      this->recon[i] = this->array[i];
+	  }
+
+	  if( verboseFlag && useBar ){
+#pragma omp critical (reconProgress)
+	    bar.update(++numDone);
+	  }
 	}
+
+	delete [] coeffs;
+	delete [] wavelet;
       }
+
       this->reconExists = true;
-      if(this->par.isVerbose()) {
+      if(verboseFlag) {
 	if(useBar) bar.fillSpace(" All Done.");
 	printSpace(std::cout,26);
 	std::cout << "\n";
@@ -243,6 +291,8 @@ namespace duchamp
     return searchReconArraySpectral(dim,originalArray,reconArray,par,stats);
   else if(par.getSearchType()=="spatial")
     return searchReconArraySpatial(dim,originalArray,reconArray,par,stats);
+  else if(par.getSearchType()=="3D")
+    return search3DArrayConnected(dim,reconArray,par,stats);
   else{
     DUCHAMPERROR("searchReconArray","Unknown search type : " << par.getSearchType());
     return std::vector<Detection>(0);
@@ -270,6 +320,8 @@ namespace duchamp
     ///  \return A vector of Detections resulting from the search.
 
     std::vector <Detection> outputList;
+    DetectionGrid grid;
+    if(par.getFlagTwoStageMerging()) grid.define(dim,par);
     size_t zdim = dim[2];
     size_t xySize = dim[0] * dim[1];
     int num=0;
@@ -282,12 +334,20 @@ namespace duchamp
 
       std::vector<bool> doPixel(xySize,false);
       // doPixel is a bool array to say whether to look in a given spectrum
-      for(size_t npix=0; npix<xySize; npix++){
-	for(size_t z=0;z<zdim && !doPixel[npix];z++) {
-	  doPixel[npix] = doPixel[npix] || (!par.isBlank(originalArray[npix+xySize*z]) && !par.isFlaggedChannel(z));
+      // (the cube is read one channel map at a time, so the reads are contiguous)
+      for(size_t z=0;z<zdim;z++) {
+	if(!par.isFlaggedChannel(z)){
+	  for(size_t npix=0; npix<xySize; npix++){
+	    if(!par.isBlank(originalArray[npix+xySize*z])) doPixel[npix] = true;
+	  }
 	}
-	// doPixel[i] is now false only when there are no good pixels in spectrum of pixel #i.
       }
+      // doPixel[i] is now false only when there are no good pixels in spectrum of pixel #i.
+
+      // The spectra are copied out of the reconstructed array in
+      // batches of adjacent pixels, so that each channel of a batch
+      // is read as a contiguous run.
+      std::vector<float> specBatch(atrousBatchSize*zdim);
 
       size_t *specdim = new size_t[2];
       specdim[0] = zdim; specdim[1]=1;
@@ -307,9 +367,16 @@ namespace duchamp
 	  size_t npix = y*dim[0] + x;
 	  if( par.isVerbose() ) bar.update(npix+1);
 
+	  if(npix % atrousBatchSize == 0){
+	    size_t batchSize = std::min(atrousBatchSize, xySize-npix);
+	    for(size_t z=0;z<zdim;z++)
+	      for(size_t b=0;b<batchSize;b++)
+		specBatch[b*zdim+z] = reconArray[z*xySize+npix+b];
+	  }
+
 	  if(doPixel[npix]){
 
-	    spectrum->extractSpectrum(reconArray,dim,npix);
+	    spectrum->saveArray(&specBatch[(npix%atrousBatchSize)*zdim],zdim);
 	    spectrum->removeFlaggedChannels();
 	    std::vector<Scan> objlist = spectrum->findSources1D();
 	    std::vector<Scan>::iterator obj;
@@ -321,7 +388,7 @@ namespace duchamp
 		newObject.addPixel(x,y,z);
 	      }
 	      newObject.setOffsets(par);
-	      if(par.getFlagTwoStageMerging()) mergeIntoList(newObject,outputList,par);
+	      if(par.getFlagTwoStageMerging()) mergeIntoList(newObject,outputList,par,grid);
 	      else outputList.push_back(newObject);
 	    }
 	  }
@@ -364,6 +431,8 @@ namespace duchamp
     ///  \return A vector of Detections resulting from the search.
 
     std::vector <Detection> outputList;
+    DetectionGrid grid;
+    if(par.getFlagTwoStageMerging()) grid.define(dim,par);
     size_t zdim = dim[2];
     int num=0;
     ProgressBar bar;
@@ -393,7 +462,7 @@ namespace duchamp
 	  Detection newObject;
 	  newObject.addChannel(z,*obj);
 	  newObject.setOffsets(par);
-	  if(par.getFlagTwoStageMerging()) mergeIntoList(newObject,outputList,par);
+	  if(par.getFlagTwoStageMerging()) mergeIntoList(newObject,outputList,par,grid);
 	  else outputList.push_back(newObject);
 	}
       }
@@ -28,6 +28,8 @@
 #ifndef ATROUS_H
 #define ATROUS_H
 
+#include <vector>
+
 namespace duchamp
 {
 
@@ -35,6 +37,45 @@ namespace duchamp
 
   const float reconTolerance = 0.005; ///< The tolerance in the reconstruction.
 
+  const size_t atrousBatchSize = 16; ///< The number of adjacent spectra reconstructed together by atrous1DReconstructBatch.
+
+  /// @brief Apply the reflection boundary conditions used in the reconstructions to a position along an axis.
+  inline void boundaryConditions(long &d, const long &dim)
+  {
+    if(dim<2){
+      d = 0;
+      return;
+    }
+    while(d<0 || d>=dim) {
+      if (d < 0) {
+	d = -d;
+      }
+      if (d >= dim) {
+	d = 2*(dim-1) - d;
+      }
+    }
+  }
+
+  /// @brief Find the array offset of each filter tap for each pixel along an axis.
+  inline void findFilterTaps(size_t dim, int filterwidth, int spacing, size_t stride,
+			     std::vector<size_t> &taps)
+  {
+    /// The offset of tap f for pixel i is stored in
+    /// taps[i*filterwidth+f], and is the (reflected) position of the
+    /// tap multiplied by stride. Looking the taps up in this table
+    /// means the convolution loops need no tests for the edges.
+
+    int filterHW = filterwidth/2;
+    taps.resize(dim*filterwidth);
+    for(size_t i=0;i<dim;i++){
+      for(int offset=-filterHW; offset<=filterHW; offset++){
+	long d = long(i) + spacing*offset;
+	boundaryConditions(d, long(dim));
+	taps[i*filterwidth+offset+filterHW] = size_t(d)*stride;
+      }
+    }
+  }
+
 
   /////////////////////////////////////////////////////////////////////////
 
@@ -42,10 +83,22 @@ namespace duchamp
   void atrous1DReconstruct(size_t &size, float *&input, 
 			   float *&output, Param &par);
 
+  /// @brief Perform a 1-dimensional a trous wavelet reconstruction, using work arrays provided by the caller.
+  void atrous1DReconstruct(size_t size, float *input, float *output, Param &par,
+			   float *coeffs, float *wavelet, std::vector<bool> &isGood, bool verbose);
+
+  /// @brief Perform 1-dimensional a trous wavelet reconstructions on a batch of interleaved spectra.
+  void atrous1DReconstructBatch(size_t xdim, size_t numSpec, size_t stride,
+				float *input, float *output, Param &par);
+
   /// @brief Perform a 2-dimensional a trous wavelet reconstruction. 
   void atrous2DReconstruct(size_t &xdim, size_t &ydim, float *&input,
 			   float *&output, Param &par);
 
+  /// @brief Perform a 2-dimensional a trous wavelet reconstruction, using work arrays provided by the caller.
+  void atrous2DReconstruct(size_t xdim, size_t ydim, float *input, float *output, Param &par,
+			   float *coeffs, float *wavelet, std::vector<bool> &isGood, bool verbose);
+
   /// @brief Perform a 3-dimensional a trous wavelet reconstruction. 
   void atrous3DReconstruct(size_t &xdim, size_t &ydim, size_t &zdim, 
 			   float *&input,float *&output, Param &par);
@@ -60,6 +113,9 @@ namespace duchamp
   /// @brief Find the baseline of a 1-D spectrum. 
   void findAtrousBaseline(size_t size, float *input, float *baseline);
 
+  /// @brief Find the baselines of a batch of interleaved 1-D spectra. 
+  void findAtrousBaseline(size_t size, size_t numSpec, size_t stride, float *input, float *baseline, Param &par);
+
 }
 
 #endif
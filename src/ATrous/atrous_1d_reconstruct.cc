@@ -35,6 +35,7 @@
 #include <duchamp/Utils/feedback.hh>
 #include <duchamp/ATrous/atrous.hh>
 #include <duchamp/ATrous/filter.hh>
+#include <duchamp/ATrous/FilterTaps.hh>
 #include <duchamp/Utils/Statistics.hh>
 using Statistics::madfmToSigma;
 
@@ -51,6 +52,9 @@ namespace duchamp
     ///  If all pixels are BLANK (and we are testing for BLANKs), the
     ///  reconstruction will simply give BLANKs back, so we return the
     ///  input array as the output array.
+    ///
+    ///  This allocates the necessary work arrays and calls the
+    ///  version of atrous1DReconstruct() that uses them.
     /// 
     ///  \param xdim The length of the spectrum.
     ///  \param input The input spectrum.
@@ -58,22 +62,49 @@ namespace duchamp
     ///    be declared beforehand.
     ///  \param par The Param set.
 
+    float *coeffs = new float[xdim];
+    float *wavelet = new float[xdim];
+    std::vector<bool> isGood(xdim);
+
+    atrous1DReconstruct(xdim,input,output,par,coeffs,wavelet,isGood,par.isVerbose());
+
+    delete [] wavelet;
+    delete [] coeffs;
+  }
+
+  void atrous1DReconstruct(size_t xdim, float *input, float *output, Param &par,
+			   float *coeffs, float *wavelet, std::vector<bool> &isGood, bool verbose)
+  {
+    ///  The a trous reconstruction of a 1-dimensional spectrum,
+    ///   using work arrays provided by the caller. These can be
+    ///   re-used from one spectrum to the next, avoiding repeated
+    ///   allocation when reconstructing many spectra.
+    ///
+    ///  The Param set is only read, never changed, so this may be
+    ///   called from several threads at once, provided each has its
+    ///   own input, output and work arrays. A scaleMax value that is
+    ///   out of range (or zero) means all scales are used: the
+    ///   caller is responsible for checking it & warning the user
+    ///   (as is done in Cube::ReconCube1D()).
+    ///
+    ///  \param xdim The length of the spectrum.
+    ///  \param input The input spectrum.
+    ///  \param output The returned reconstructed spectrum. This array needs to 
+    ///    be declared beforehand.
+    ///  \param par The Param set.
+    ///  \param coeffs Work array, of length xdim.
+    ///  \param wavelet Work array, of length xdim.
+    ///  \param isGood Work array, of length xdim, used for the mask of non-BLANK pixels.
+    ///  \param verbose Whether to write the progress of the iterations to the screen.
+
     const float SNR_THRESH=par.getAtrousCut();
     unsigned int MIN_SCALE=par.getMinScale();
     unsigned int MAX_SCALE=par.getMaxScale();
-    static bool firstTime = true;  // need this static in case we do two reconstructions - e.g. baseline subtraction
 
     unsigned int numScales = par.filter().getNumScales(xdim);
-    if((MAX_SCALE>0)&&(MAX_SCALE<=numScales))
-      MAX_SCALE = std::min(MAX_SCALE,numScales);
-    else{
-      if((firstTime)&&(MAX_SCALE!=0)){
-	firstTime=false;
-	DUCHAMPWARN("Reading parameters","The requested value of the parameter scaleMax, \"" << par.getMaxScale() << "\" is outside the allowed range (1-"<< numScales <<") -- setting to " << numScales);
-      } 
+    if((MAX_SCALE==0)||(MAX_SCALE>numScales))
       MAX_SCALE = numScales;
-      par.setMaxScale(MAX_SCALE);
-    }
+
     double *sigmaFactors = new double[numScales+1];
     for(size_t i=0;i<=numScales;i++){
       if(i<=par.filter().maxFactor(1)) 
@@ -82,7 +113,6 @@ namespace duchamp
     }
 
     float mean,originalSigma,oldsigma,newsigma;
-    std::vector<bool> isGood(xdim);
     size_t goodSize=0;
     for(size_t pos=0;pos<xdim;pos++) {
       isGood[pos] = !par.isBlank(input[pos]);
@@ -100,24 +130,31 @@ namespace duchamp
       // Otherwise, all is good, and we continue.
 
 
-      float *coeffs = new float[xdim];
-      float *wavelet = new float[xdim];
       // float *residual = new float[xdim];
 
       for(size_t pos=0;pos<xdim;pos++) output[pos]=0.;
 
-      int filterHW = par.filter().width()/2;
-      double *filter = new double[par.filter().width()];
-      for(size_t i=0;i<par.filter().width();i++) filter[i] = par.filter().coeff(i);
+      int filterwidth = par.filter().width();
+      double *filter = new double[filterwidth];
+      for(int i=0;i<filterwidth;i++) filter[i] = par.filter().coeff(i);
+      std::vector<size_t> tap(xdim*filterwidth);
 
 
       // No trimming done in 1D case.
 
+      // findMedianStats(input,xdim,isGood,originalMean,originalSigma);
+      // originalSigma = madfmToSigma(originalSigma); 
+      // This doesn't change between iterations, so only find it once.
+      if(par.getFlagRobustStats())
+	originalSigma = madfmToSigma(findMADFM(input,isGood,xdim));
+      else
+	originalSigma = findStddev<float>(input,isGood,xdim);
+
       float threshold;
       int iteration=0;
       newsigma = 1.e9;
       do{
-	if(par.isVerbose()) {
+	if(verbose) {
 	  std::cout << "Iteration #"<<++iteration<<":";
 	  printSpace(std::cout,13);
 	}
@@ -126,22 +163,18 @@ namespace duchamp
 	oldsigma = newsigma;
 	// all other times round, we are transforming the residual array
 	for(size_t i=0;i<xdim;i++)  coeffs[i] = input[i] - output[i];
-    
-	// findMedianStats(input,xdim,isGood,originalMean,originalSigma);
-	// originalSigma = madfmToSigma(originalSigma); 
-	if(par.getFlagRobustStats())
-	  originalSigma = madfmToSigma(findMADFM(input,isGood,xdim));
-	else
-	  originalSigma = findStddev<float>(input,isGood,xdim);
 
 	int spacing = 1;
 	for(unsigned int scale = 1; scale<=numScales; scale++){
 
-	  if(par.isVerbose()) {
+	  if(verbose) {
 	    std::cout << "Scale " << std::setw(2) << scale
 		      << " /"     << std::setw(2) << numScales <<std::flush;
 	  }
 
+	  // find the (reflected) location of each filter tap for each pixel
+	  findFilterTaps(xdim, filterwidth, spacing, 1, tap);
+
 	  for(size_t xpos = 0; xpos<xdim; xpos++){
 	    // loops over each pixel in the image
 
@@ -150,22 +183,11 @@ namespace duchamp
 	    if(!isGood[xpos] )  wavelet[xpos] = 0.;
 	    else{
 
-	      for(int xoffset=-filterHW; xoffset<=filterHW; xoffset++){
-		long x = xpos + spacing*xoffset;
-
-		while((x<0)||(x>=long(xdim))){
-		  // boundary conditions are reflection. 
-		  if(x<0) x = 0 - x;
-		  else if(x>=long(xdim)) x = 2*(xdim-1) - x;
-		}
-
-		size_t filterpos = (xoffset+filterHW);
-		size_t oldpos = x;
-
-		if(isGood[oldpos]) 
-		  wavelet[xpos] -= filter[filterpos]*coeffs[oldpos];
-	      
-	      } //-> end of xoffset loop
+	      const size_t *oldpos = &tap[xpos*filterwidth];
+	      for(int filterpos=0; filterpos<filterwidth; filterpos++){
+		if(isGood[oldpos[filterpos]]) 
+		  wavelet[xpos] -= filter[filterpos]*coeffs[oldpos[filterpos]];
+	      } //-> end of filterpos loop
 	    } //-> end of else{ ( from if(!isGood[xpos])  )
 	    
 	  } //-> end of xpos loop
@@ -207,21 +229,225 @@ namespace duchamp
 	else
 	  newsigma = findStddevDiff<float>(input,output,isGood,xdim);
 
-	if(par.isVerbose()) printBackSpace(std::cout,26);
+	if(verbose) printBackSpace(std::cout,26);
 
       } while( (iteration==1) || 
 	       (fabs(oldsigma-newsigma)/newsigma > par.getReconConvergence()) );
 
-      if(par.isVerbose()) std::cout << "Completed "<<iteration<<" iterations. ";
+      if(verbose) std::cout << "Completed "<<iteration<<" iterations. ";
 
       delete [] filter;
       // delete [] residual;
-      delete [] wavelet;
-      delete [] coeffs;
 
     }
 
     delete [] sigmaFactors;
   }
 
+  template <class Taps>
+  void atrousBatchWavelets(float *coeffs, float *wavelet, const char *isGood,
+			   size_t xdim, size_t numSpec, int spacing, Filter &filter)
+  {
+    ///  Find the wavelet coefficients at one scale for a batch of
+    ///   interleaved spectra (as used by atrous1DReconstructBatch()),
+    ///   for a given set of filter taps (see FilterTaps.hh). Taps
+    ///   with a zero coefficient are skipped.
+    ///
+    ///  \param coeffs The coefficients from the previous scale.
+    ///  \param wavelet The wavelet coefficients found at this scale.
+    ///  \param isGood Which pixels are not BLANK.
+    ///  \param xdim The length of each spectrum.
+    ///  \param numSpec The number of spectra in the batch.
+    ///  \param spacing The separation of the filter taps.
+    ///  \param filter The filter being used.
+
+    Taps taps(filter);
+    const int filterwidth = taps.width();
+
+    // find the (reflected) location of each filter tap for each channel
+    std::vector<size_t> tap;
+    findFilterTaps(xdim, filterwidth, spacing, numSpec, tap);
+
+    for(size_t z=0;z<xdim;z++){
+      float *wav = &wavelet[z*numSpec];
+      const float *coe = &coeffs[z*numSpec];
+      const char *good = &isGood[z*numSpec];
+      for(size_t b=0;b<numSpec;b++) wav[b] = good[b] ? coe[b] : 0.;
+      for(int f=0;f<filterwidth;f++){
+	const double coeff = taps.coeff(f);
+	if(coeff==0.) continue;
+	const float *oldcoe = &coeffs[tap[z*filterwidth+f]];
+	const char *oldgood = &isGood[tap[z*filterwidth+f]];
+	for(size_t b=0;b<numSpec;b++)
+	  wav[b] -= (good[b] && oldgood[b]) ? coeff*oldcoe[b] : 0.;
+      }
+    }
+  }
+
+  typedef void (*BatchWaveletFinder)(float *, float *, const char *, size_t, size_t, int, Filter &);
+
+  void atrous1DReconstructBatch(size_t xdim, size_t numSpec, size_t stride,
+				float *input, float *output, Param &par)
+  {
+    ///  Reconstruct a batch of numSpec spectra at once with the a
+    ///   trous method. The spectra are interleaved in the input
+    ///   array: channel z of spectrum b is at input[z*stride+b]. For
+    ///   a cube this means numSpec adjacent spatial pixels with
+    ///   stride=xdim*ydim, so that each channel is read as a single
+    ///   contiguous run rather than as numSpec widely-separated
+    ///   values. The convolution and the pixel-by-pixel operations
+    ///   then work along the batch in the innermost loop, where they
+    ///   can be vectorised.
+    ///
+    ///  Each spectrum is treated exactly as atrous1DReconstruct()
+    ///   would treat it (with no verbose output), including its own
+    ///   statistics and its own convergence test, so the results are
+    ///   identical to reconstructing the spectra one at a time. The
+    ///   batch keeps iterating until every spectrum has converged,
+    ///   with each spectrum's result saved at the point it converges.
+    ///
+    ///  Like the other version, the Param set is only read, so this
+    ///   may be called from several threads at once.
+    ///
+    ///  \param xdim The length of each spectrum.
+    ///  \param numSpec The number of spectra in the batch (best kept
+    ///  to about atrousBatchSize).
+    ///  \param stride The separation in the arrays between successive
+    ///  channels of a given spectrum. Must be at least numSpec.
+    ///  \param input The input spectra.
+    ///  \param output The reconstructed spectra, in the same layout as
+    ///  the input. This array needs to be declared beforehand.
+    ///  \param par The Param set.
+
+    const float SNR_THRESH=par.getAtrousCut();
+    unsigned int MIN_SCALE=par.getMinScale();
+    unsigned int MAX_SCALE=par.getMaxScale();
+
+    unsigned int numScales = par.filter().getNumScales(xdim);
+    if((MAX_SCALE==0)||(MAX_SCALE>numScales))
+      MAX_SCALE = numScales;
+
+    std::vector<double> sigmaFactors(numScales+1);
+    for(size_t i=0;i<=numScales;i++){
+      if(i<=par.filter().maxFactor(1)) 
+	sigmaFactors[i] = par.filter().sigmaFactor(1,i);
+      else sigmaFactors[i] = sigmaFactors[i-1] / sqrt(2.);
+    }
+
+    // Use the convolution kernel specialised for the filter, where there is one.
+    static const BatchWaveletFinder finders[numFilterTaps] = {
+      &atrousBatchWavelets<RuntimeTaps>,
+      &atrousBatchWavelets<B3SplineTaps>,
+      &atrousBatchWavelets<TriangleTaps>,
+      &atrousBatchWavelets<HaarTaps>
+    };
+    BatchWaveletFinder findWavelets = finders[filterTapsIndex(par.filter())];
+
+    // Work arrays, all with the spectra interleaved (channel z of
+    // spectrum b is at z*numSpec+b)
+    size_t size = xdim * numSpec;
+    std::vector<float> in(size), out(size,0.), coeffs(size), wavelet(size);
+    std::vector<char> isGood(size);
+    for(size_t z=0;z<xdim;z++){
+      for(size_t b=0;b<numSpec;b++){
+	in[z*numSpec+b] = input[z*stride+b];
+	isGood[z*numSpec+b] = !par.isBlank(in[z*numSpec+b]);
+      }
+    }
+
+    // Single-spectrum versions, used for the statistics
+    std::vector< std::vector<bool> > specGood(numSpec, std::vector<bool>(xdim));
+    std::vector<float> spec(xdim), specOut(xdim);
+
+    std::vector<float> originalSigma(numSpec), oldsigma(numSpec), newsigma(numSpec,1.e9), threshold(numSpec);
+    std::vector<bool> done(numSpec,false);
+    size_t numLeft = numSpec;
+    for(size_t b=0;b<numSpec;b++){
+      size_t goodSize=0;
+      for(size_t z=0;z<xdim;z++){
+	specGood[b][z] = isGood[z*numSpec+b];
+	if(specGood[b][z]) goodSize++;
+	spec[z] = in[z*numSpec+b];
+      }
+      if(goodSize == 0){
+	// There are no good pixels -- return the input spectrum as the output.
+	for(size_t z=0;z<xdim;z++) output[z*stride+b] = input[z*stride+b];
+	done[b] = true;
+	numLeft--;
+      }
+      else if(par.getFlagRobustStats())
+	originalSigma[b] = madfmToSigma(findMADFM(&spec[0],specGood[b],xdim));
+      else
+	originalSigma[b] = findStddev<float>(&spec[0],specGood[b],xdim);
+    }
+
+    while(numLeft>0){
+
+      for(size_t b=0;b<numSpec;b++) oldsigma[b] = newsigma[b];
+      // we are transforming the residual array
+      for(size_t i=0;i<size;i++)  coeffs[i] = in[i] - out[i];
+
+      int spacing = 1;
+      for(unsigned int scale = 1; scale<=numScales; scale++){
+
+	findWavelets(&coeffs[0], &wavelet[0], &isGood[0], xdim, numSpec, spacing, par.filter());
+
+	// Need to do this after we've done *all* the convolving
+	for(size_t i=0;i<size;i++) coeffs[i] = coeffs[i] - wavelet[i];
+
+	// Have found wavelet coeffs for this scale -- now threshold
+	if(scale>=MIN_SCALE && scale <=MAX_SCALE){
+	  for(size_t b=0;b<numSpec;b++){
+	    if(!done[b]){
+	      float mean;
+	      for(size_t z=0;z<xdim;z++) spec[z] = wavelet[z*numSpec+b];
+	      if(par.getFlagRobustStats())
+		mean = findMedian<float>(&spec[0],specGood[b],xdim);
+	      else
+		mean = findMean<float>(&spec[0],specGood[b],xdim);
+	      threshold[b] = mean+SNR_THRESH*originalSigma[b]*sigmaFactors[scale];
+	    }
+	  }
+	  for(size_t z=0;z<xdim;z++){
+	    for(size_t b=0;b<numSpec;b++){
+	      size_t pos = z*numSpec+b;
+	      // preserve the Blank pixel values in the output.
+	      if(!isGood[pos]) out[pos] = in[pos];
+	      else if( fabs(wavelet[pos]) > threshold[b] )
+		out[pos] += wavelet[pos];
+	    }
+	  }
+	}
+ 
+	spacing *= 2;
+
+      } //-> end of scale loop 
+
+      for(size_t i=0;i<size;i++) 
+	if(isGood[i]) out[i] += coeffs[i];
+
+      // Test each spectrum for convergence, saving those that have finished
+      for(size_t b=0;b<numSpec;b++){
+	if(!done[b]){
+	  for(size_t z=0;z<xdim;z++){
+	    spec[z] = in[z*numSpec+b];
+	    specOut[z] = out[z*numSpec+b];
+	  }
+	  if(par.getFlagRobustStats())
+	    newsigma[b] = madfmToSigma(findMADFMDiff(&spec[0],&specOut[0],specGood[b],xdim));
+	  else
+	    newsigma[b] = findStddevDiff<float>(&spec[0],&specOut[0],specGood[b],xdim);
+
+	  if(!(fabs(oldsigma[b]-newsigma[b])/newsigma[b] > par.getReconConvergence())){
+	    for(size_t z=0;z<xdim;z++) output[z*stride+b] = specOut[z];
+	    done[b] = true;
+	    numLeft--;
+	  }
+	}
+      }
+
+    }
+
+  }
+
 }
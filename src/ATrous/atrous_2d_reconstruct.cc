@@ -27,14 +27,18 @@
 // -----------------------------------------------------------------------
 #include <iostream>
 #include <iomanip>
+#include <vector>
+#include <algorithm>
 #include <math.h>
 #include <duchamp/duchamp.hh>
 #include <duchamp/param.hh>
 #include <duchamp/ATrous/atrous.hh>
 #include <duchamp/ATrous/filter.hh>
+#include <duchamp/ATrous/FilterTaps.hh>
 #include <duchamp/Utils/utils.hh>
 #include <duchamp/Utils/feedback.hh>
 #include <duchamp/Utils/Statistics.hh>
+#include <duchamp/Utils/StreamingMedian.hh>
 using Statistics::madfmToSigma;
 
 namespace duchamp
@@ -48,6 +52,9 @@ namespace duchamp
     ///  If there are no non-BLANK pixels (and we are testing for
     ///  BLANKs), the reconstruction cannot be done, so we return the
     ///  input array as the output array and give a warning message.
+    ///
+    ///  This allocates the necessary work arrays and calls the
+    ///  version of atrous2DReconstruct() that uses them.
     /// 
     ///  \param xdim The length of the x-axis of the image.
     ///  \param ydim The length of the y-axis of the image.
@@ -57,6 +64,107 @@ namespace duchamp
     ///  \param par The Param set:contains all necessary info about the
     ///  filter and reconstruction parameters.
 
+    size_t size = xdim * ydim;
+    float *coeffs    = new float[size];
+    float *wavelet   = new float[size];
+    std::vector<bool> isGood(size);
+
+    atrous2DReconstruct(xdim,ydim,input,output,par,coeffs,wavelet,isGood,par.isVerbose());
+
+    delete [] coeffs;
+    delete [] wavelet;
+  }
+
+  template <class Taps>
+  void atrous2DWavelets(float *coeffs, float *wavelet, std::vector<bool> &isGood,
+			size_t xdim, size_t ydim, int spacing, Filter &filter)
+  {
+    ///  Find the wavelet coefficients of an image at one scale, by
+    ///   convolving the coefficients from the previous scale with
+    ///   the 2D filter (the outer product of the 1D filter with
+    ///   itself) and subtracting. This is done for a given set of
+    ///   filter taps (see FilterTaps.hh), a row at a time and one tap
+    ///   at a time, so that the loops along the rows are simple
+    ///   enough to be vectorised. Each pixel has the taps subtracted
+    ///   in the same order whichever version is used. Taps with a
+    ///   zero coefficient are skipped.
+    ///
+    ///  \param coeffs The coefficients from the previous scale.
+    ///  \param wavelet The wavelet coefficients found at this scale.
+    ///  \param isGood Which pixels are not BLANK.
+    ///  \param xdim The length of the x-axis of the image.
+    ///  \param ydim The length of the y-axis of the image.
+    ///  \param spacing The separation of the filter taps.
+    ///  \param filter The filter being used.
+
+    Taps taps(filter);
+    const int filterwidth = taps.width();
+    const int filterHW = filterwidth/2;
+
+    // find the (reflected) location of each filter tap along each axis
+    std::vector<size_t> xtap, ytap;
+    findFilterTaps(xdim, filterwidth, spacing, 1, xtap);
+    findFilterTaps(ydim, filterwidth, spacing, xdim, ytap);
+    long edge = std::min(long(filterHW)*spacing, long(xdim));
+    long interiorEnd = std::max(edge, long(xdim)-edge);
+
+    std::vector<char> good(xdim);
+    for(size_t ypos = 0; ypos<ydim; ypos++){
+      size_t row = ypos*xdim;
+      float *wav = wavelet + row;
+      for(size_t xpos = 0; xpos<xdim; xpos++){
+	good[xpos] = isGood[row+xpos];
+	wav[xpos] = good[xpos] ? coeffs[row+xpos] : 0.;
+      }
+
+      for(int fy=0; fy<filterwidth; fy++){
+	const float *tapRow = coeffs + ytap[ypos*filterwidth+fy];
+	for(int fx=0; fx<filterwidth; fx++){
+	  const double coeff = taps.coeff(fy) * taps.coeff(fx);
+	  if(coeff==0.) continue;
+	  // pixels away from the ends of the row, whose taps need no reflection
+	  const float *tapIn = tapRow + long(fx-filterHW)*spacing;
+	  for(long xpos=edge; xpos<interiorEnd; xpos++)
+	    wav[xpos] -= good[xpos] ? coeff * tapIn[xpos] : 0.;
+	  // the ends of the row
+	  for(long xpos=0; xpos<long(xdim); xpos++){
+	    if(xpos==edge) xpos = interiorEnd;
+	    if(xpos>=long(xdim)) break;
+	    if(good[xpos]) wav[xpos] -= coeff * tapRow[xtap[xpos*filterwidth+fx]];
+	  }
+	}
+      }
+    }
+  }
+
+  typedef void (*WaveletFinder2D)(float *, float *, std::vector<bool> &, size_t, size_t, int, Filter &);
+
+  void atrous2DReconstruct(size_t xdim, size_t ydim, float *input, float *output, Param &par,
+			   float *coeffs, float *wavelet, std::vector<bool> &isGood, bool verbose)
+  {
+    ///  The a trous reconstruction of a 2-dimensional image, using
+    ///   work arrays provided by the caller, so that they can be
+    ///   re-used from one image to the next.
+    ///
+    ///  The Param set is only read, never changed, so this may be
+    ///   called from several threads at once, provided each has its
+    ///   own input, output and work arrays. A scaleMax value that is
+    ///   out of range (or zero) means all scales are used: the
+    ///   caller is responsible for checking it & warning the user
+    ///   (as is done in Cube::ReconCube2D()).
+    ///
+    ///  \param xdim The length of the x-axis of the image.
+    ///  \param ydim The length of the y-axis of the image.
+    ///  \param input The input image.
+    ///  \param output The returned reconstructed image. This array
+    ///  needs to be declared beforehand.
+    ///  \param par The Param set:contains all necessary info about the
+    ///  filter and reconstruction parameters.
+    ///  \param coeffs Work array, of length xdim*ydim.
+    ///  \param wavelet Work array, of length xdim*ydim.
+    ///  \param isGood Work array, of length xdim*ydim, used for the mask of non-BLANK pixels.
+    ///  \param verbose Whether to write the progress of the iterations to the screen.
+
     const float SNR_THRESH=par.getAtrousCut();
     unsigned int MIN_SCALE=par.getMinScale();
     unsigned int MAX_SCALE=par.getMaxScale();
@@ -66,14 +174,8 @@ namespace duchamp
     if (ydim<mindim) mindim = ydim;
 
     unsigned int numScales = par.filter().getNumScales(mindim);
-    if((MAX_SCALE>0)&&(MAX_SCALE<=numScales))
-      MAX_SCALE = std::min(MAX_SCALE,numScales);
-    else{
-      if((MAX_SCALE!=0))
-	DUCHAMPWARN("Reading parameters","The requested value of the parameter scaleMax, \"" << par.getMaxScale() << "\" is outside the allowed range (1-"<< numScales <<") -- setting to " << numScales);
+    if((MAX_SCALE==0)||(MAX_SCALE>numScales))
       MAX_SCALE = numScales;
-      par.setMaxScale(MAX_SCALE);
-    }
 
     double *sigmaFactors = new double[numScales+1];
     for(size_t i=0;i<=numScales;i++){
@@ -84,7 +186,6 @@ namespace duchamp
 
     float mean,originalSigma,oldsigma,newsigma;
     size_t goodSize=0;
-    std::vector<bool> isGood(size);
     for(size_t pos=0;pos<size;pos++){
       isGood[pos] = !par.isBlank(input[pos]);
       if(isGood[pos]) goodSize++;
@@ -104,24 +205,22 @@ namespace duchamp
       //      findMedianStats(input,goodSize,isGood,originalMean,originalSigma);
       // originalSigma = madfmToSigma(originalSigma);
       if(par.getFlagRobustStats())
-	originalSigma = madfmToSigma(findMADFM(input,isGood,size));
+	originalSigma = madfmToSigma(Statistics::findMADFMStreaming(input,isGood,size));
       else
 	originalSigma = findStddev<float>(input,isGood,size);
   
-      float *coeffs    = new float[size];
-      float *wavelet   = new float[size];
       // float *residual  = new float[size];
 
       for(size_t pos=0;pos<size;pos++) output[pos]=0.;
 
-      unsigned int filterwidth = par.filter().width();
-      int filterHW = filterwidth/2;
-      double *filter = new double[filterwidth*filterwidth];
-      for(size_t i=0;i<filterwidth;i++){
-	for(size_t j=0;j<filterwidth;j++){
-	  filter[i*filterwidth+j] = par.filter().coeff(i) * par.filter().coeff(j);
-	}
-      }
+      // Use the convolution kernel specialised for the filter, where there is one.
+      static const WaveletFinder2D finders[numFilterTaps] = {
+	&atrous2DWavelets<RuntimeTaps>,
+	&atrous2DWavelets<B3SplineTaps>,
+	&atrous2DWavelets<TriangleTaps>,
+	&atrous2DWavelets<HaarTaps>
+      };
+      WaveletFinder2D findWavelets = finders[filterTapsIndex(par.filter())];
 
       // long *xLim1 = new long[ydim];
       // for(size_t i=0;i<ydim;i++) xLim1[i] = 0;
@@ -166,7 +265,7 @@ namespace duchamp
       newsigma = 1.e9;
       for(size_t i=0;i<size;i++) output[i] = 0;
       do{
-	if(par.isVerbose()) {
+	if(verbose) {
 	  std::cout << "Iteration #"<<std::setw(2)<<++iteration<<":";
 	  printBackSpace(std::cout,13);
 	}
@@ -180,80 +279,14 @@ namespace duchamp
 	int spacing = 1;
 	for(unsigned int scale = 1; scale<numScales; scale++){
 
-	  if(par.isVerbose()){
+	  if(verbose){
 	    std::cout << "Scale ";
 	    std::cout << std::setw(2)<<scale<<" / "<<std::setw(2)<<numScales;
 	    printBackSpace(std::cout,13);
 	    std::cout <<std::flush;
 	  }
 
-	  for(unsigned long ypos = 0; ypos<ydim; ypos++){
-	    for(unsigned long xpos = 0; xpos<xdim; xpos++){
-	      // loops over each pixel in the image
-	      size_t pos = ypos*xdim + xpos;
-	  
-	      wavelet[pos] = coeffs[pos];
-
-	      if(!isGood[pos]) wavelet[pos] = 0.;
-	      else{
-
-		size_t filterpos = 0;
-		for(int yoffset=-filterHW; yoffset<=filterHW; yoffset++){
-		  long y = long(ypos) + spacing*yoffset;
-		  while((y<0)||(y>=long(ydim))){
-		    // boundary conditions are reflection. 
-		    if(y<0) y = 0 - y;
-		    else if(y>=long(ydim)) y = 2*(ydim-1) - y;
-		  }
-		  // Boundary conditions -- assume reflection at boundaries.
-		  // Use limits as calculated above
-		  // 	      if(yLim1[xpos]!=yLim2[xpos]){ 
-		  // 		// if these are equal we will get into an infinite loop here 
-		  // 		while((y<yLim1[xpos])||(y>yLim2[xpos])){
-		  // 		  if(y<yLim1[xpos]) y = 2*yLim1[xpos] - y;      
-		  // 		  else if(y>yLim2[xpos]) y = 2*yLim2[xpos] - y;      
-		  // 		}
-		  // 	      }
-		  size_t oldrow = y * xdim;
-	  
-		  for(int xoffset=-filterHW; xoffset<=filterHW; xoffset++){
-		    long x = long(xpos) + spacing*xoffset;
-		    while((x<0)||(x>=long(xdim))){
-		      // boundary conditions are reflection. 
-		      if(x<0) x = 0 - x;
-		      else if(x>=long(xdim)) x = 2*(xdim-1) - x;
-		    }
-		    // Boundary conditions -- assume reflection at boundaries.
-		    // Use limits as calculated above
-		    // 		if(xLim1[ypos]!=xLim2[ypos]){
-		    // 		  // if these are equal we will get into an infinite loop here 
-		    // 		  while((x<xLim1[ypos])||(x>xLim2[ypos])){
-		    // 		    if(x<xLim1[ypos]) x = 2*xLim1[ypos] - x;      
-		    // 		    else if(x>xLim2[ypos]) x = 2*xLim2[ypos] - x;      
-		    // 		  }
-		    // 		}
-
-		    size_t oldpos = oldrow + x;
-
-		    // float oldCoeff;
-		    // if((y>=yLim1[xpos])&&(y<=yLim2[xpos])&&
-		    //    (x>=xLim1[ypos])&&(x<=xLim2[ypos])  )
-		    //   oldCoeff = coeffs[oldpos];
-		    // else oldCoeff = 0.;
-
-		    // if(isGood[pos]) wavelet[pos] -= filter[filterpos] * oldCoeff;
-		    // // 		  wavelet[pos] -= filter[filterpos] * coeffs[oldpos];
-		    if(isGood[pos]) 
-		      wavelet[pos] -= filter[filterpos] * coeffs[oldpos];
-
-		    filterpos++;
-
-		  } //-> end of xoffset loop
-		} //-> end of yoffset loop
-	      } //-> end of else{ ( from if(!isGood[pos])  )
-	
-	    } //-> end of xpos loop
-	  } //-> end of ypos loop
+	  findWavelets(coeffs, wavelet, isGood, xdim, ydim, spacing, par.filter());
 
 	  // Need to do this after we've done *all* the convolving
 	  for(size_t pos=0;pos<size;pos++) coeffs[pos] = coeffs[pos] - wavelet[pos];
@@ -262,7 +295,7 @@ namespace duchamp
 	  if(scale>=MIN_SCALE && scale <=MAX_SCALE){
 	    //	    findMedianStats(wavelet,goodSize,isGood,mean,sigma);
 	    if(par.getFlagRobustStats())
-	      mean = findMedian<float>(wavelet,isGood,size);
+	      mean = Statistics::findMedianStreaming(wavelet,isGood,size);
 	    else
 	      mean= findMean<float>(wavelet,isGood,size);
 
@@ -285,24 +318,21 @@ namespace duchamp
 	// findMedianStatsDiff(input,output,size,isGood,mean,newsigma);
 	// newsigma = madfmToSigma(newsigma); 
 	if(par.getFlagRobustStats())
-	  newsigma = madfmToSigma(findMADFMDiff(input,output,isGood,size));
+	  newsigma = madfmToSigma(Statistics::findMADFMDiffStreaming(input,output,isGood,size));
 	else
 	  newsigma = findStddevDiff<float>(input,output,isGood,size);
 
-	if(par.isVerbose()) printBackSpace(std::cout,15);
+	if(verbose) printBackSpace(std::cout,15);
 
       } while( (iteration==1) || 
 	       (fabs(oldsigma-newsigma)/newsigma > par.getReconConvergence()) );
 
-      if(par.isVerbose()) std::cout << "Completed "<<iteration<<" iterations. ";
+      if(verbose) std::cout << "Completed "<<iteration<<" iterations. ";
 
       // delete [] xLim1;
       // delete [] xLim2;
       // delete [] yLim1;
       // delete [] yLim2;
-      delete [] filter;
-      delete [] coeffs;
-      delete [] wavelet;
       // delete [] residual;
 
     }
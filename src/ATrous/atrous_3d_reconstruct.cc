@@ -27,14 +27,18 @@
 // -----------------------------------------------------------------------
 #include <iostream>
 #include <iomanip>
+#include <vector>
+#include <algorithm>
 #include <math.h>
 #include <duchamp/duchamp.hh>
 #include <duchamp/param.hh>
 #include <duchamp/ATrous/atrous.hh>
 #include <duchamp/ATrous/filter.hh>
+#include <duchamp/ATrous/FilterTaps.hh>
 #include <duchamp/Utils/utils.hh>
 #include <duchamp/Utils/feedback.hh>
 #include <duchamp/Utils/Statistics.hh>
+#include <duchamp/Utils/StreamingMedian.hh>
 using Statistics::madfmToSigma;
 
 using std::endl;
@@ -42,15 +46,800 @@ using std::setw;
 
 namespace duchamp
 {
-    inline void boundaryConditions(long &d, const long &dim) {
-        while(d<0 || d>=dim) {
-            if (d < 0) {
-                d = -d;
+    template <class Taps>
+    void atrousSmoothAxisKernel(float *input, float *output, std::vector<bool> *mask,
+            size_t size, long dim, size_t stride, int spacing, Param &par)
+    {
+        ///  The convolution done by atrousSmoothAxis(), for a given
+        ///   set of filter taps (see FilterTaps.hh). The sums for a
+        ///   run of output pixels are built up one tap at a time in
+        ///   a buffer, so that the loops over pixels are simple
+        ///   enough to be vectorised. Each pixel still has its taps
+        ///   added in the same order, so the result does not depend
+        ///   on which version of the kernel is used. Taps with a zero
+        ///   coefficient are skipped.
+
+        Taps taps(par.filter());
+        const int filterwidth = taps.width();
+        const int filterHW = filterwidth/2;
+
+        std::vector<size_t> tapTable;
+        findFilterTaps(dim, filterwidth, spacing, stride, tapTable);
+
+        size_t blocksize = stride * dim;
+
+        if(stride==1){
+            long numRows = long(size / dim);
+            long edge = std::min(long(filterHW)*spacing, long(dim));
+            long interiorEnd = std::max(edge, long(dim)-edge);
+
+#pragma omp parallel num_threads(par.getNumThreads())
+            {
+                std::vector<double> sum(dim);
+                std::vector<char> good(dim,1);
+
+#pragma omp for schedule(static)
+                for(long row=0; row<numRows; row++){
+                    size_t block = row * dim;
+                    float *in = input + block;
+                    if(mask)
+                        for(long pix=0; pix<long(dim); pix++) good[pix] = (*mask)[block+pix];
+                    for(long pix=0; pix<long(dim); pix++) sum[pix] = 0.;
+
+                    for(int f=0;f<filterwidth;f++){
+                        const double coeff = taps.coeff(f);
+                        if(coeff==0.) continue;
+                        // Pixels away from the ends of the row, whose taps need no reflection
+                        long shift = long(f-filterHW)*spacing;
+                        const float *tapIn = in + shift;
+                        if(mask){
+                            const char *tapGood = &good[0] + shift;
+                            for(long pix=edge; pix<interiorEnd; pix++)
+                                sum[pix] += tapGood[pix] ? coeff*tapIn[pix] : 0.;
+                        }
+                        else{
+                            for(long pix=edge; pix<interiorEnd; pix++)
+                                sum[pix] += coeff*tapIn[pix];
+                        }
+                        // The ends of the row
+                        for(long pix=0; pix<long(dim); pix++){
+                            if(pix==edge) pix = interiorEnd;
+                            if(pix>=long(dim)) break;
+                            size_t tap = tapTable[pix*filterwidth+f];
+                            if(good[tap]) sum[pix] += coeff*in[tap];
+                        }
+                    }
+
+                    float *out = output + block;
+                    for(long pix=0; pix<long(dim); pix++) out[pix] = sum[pix];
+                }
+            }
+        }
+        else{
+            long numLines = long(size / blocksize) * dim;
+            const size_t chunk = std::min(stride, size_t(4096));
+
+#pragma omp parallel num_threads(par.getNumThreads())
+            {
+                std::vector<double> sum(chunk);
+
+#pragma omp for schedule(static)
+                for(long line=0; line<numLines; line++){
+                    size_t block = (line / dim) * blocksize;
+                    long pix = line % dim;
+                    const size_t *tap = &tapTable[pix*filterwidth];
+                    size_t pos = block + pix*stride;
+
+                    for(size_t start=0; start<stride; start+=chunk){
+                        size_t len = std::min(chunk, stride-start);
+                        for(size_t i=0; i<len; i++) sum[i] = 0.;
+                        for(int f=0;f<filterwidth;f++){
+                            const double coeff = taps.coeff(f);
+                            if(coeff==0.) continue;
+                            size_t oldpos = block + tap[f] + start;
+                            const float *tapIn = input + oldpos;
+                            if(mask){
+                                for(size_t i=0; i<len; i++)
+                                    if((*mask)[oldpos+i]) sum[i] += coeff*tapIn[i];
+                            }
+                            else{
+                                for(size_t i=0; i<len; i++)
+                                    sum[i] += coeff*tapIn[i];
+                            }
+                        }
+                        float *out = output + pos + start;
+                        for(size_t i=0; i<len; i++) out[i] = sum[i];
+                    }
+                }
+            }
+        }
+
+    }
+
+    typedef void (*AxisSmoother)(float *, float *, std::vector<bool> *, size_t, long, size_t, int, Param &);
+
+    void atrousSmoothAxis(float *input, float *output, std::vector<bool> *mask,
+            size_t size, long dim, size_t stride, int spacing, Param &par)
+    {
+        ///  Convolve a 3D array with the 1D wavelet filter along a
+        ///   single axis, leaving the other two axes untouched. The
+        ///   axis is defined by its length and the stride between
+        ///   successive pixels along it (1 for x, xdim for y, and
+        ///   xdim*ydim for z). Reflection boundary conditions are
+        ///   used, as for the rest of the reconstruction.
+        ///
+        ///  Since the 3D filter is the outer product of the 1D
+        ///   filter, applying this in turn along each axis gives the
+        ///   same result as the full 3D convolution. Pixels that are
+        ///   not set in the mask (if one is given) are excluded from
+        ///   the sum, so the mask should only be given for the first
+        ///   of the three passes.
+        ///
+        ///  \param input The array to be convolved.
+        ///  \param output The convolved array. Must be declared
+        ///  beforehand, and be different to input.
+        ///  \param mask Optional mask of good pixels. Use NULL to include
+        ///  all pixels.
+        ///  \param size The total number of pixels in the array.
+        ///  \param dim The length of the axis being convolved.
+        ///  \param stride The separation in the array of successive
+        ///  pixels along the axis.
+        ///  \param spacing The separation of the filter taps, in pixels.
+        ///  \param par The Param set, holding the filter and the
+        ///  number of threads to use.
+        ///
+        ///  The work is done by atrousSmoothAxisKernel(), using the
+        ///  version specialised for the filter in use where there is
+        ///  one. Each output line (one pixel along the axis, with all
+        ///  "stride" pixels that follow it) is independent of the
+        ///  others, so the lines are shared out between the threads.
+        ///  For the x-axis (stride of 1) the lines are single pixels,
+        ///  so the rows are shared out instead, and the pixels away
+        ///  from the ends of each row, whose taps need no reflection,
+        ///  are done in a simple loop.
+
+        static const AxisSmoother kernels[numFilterTaps] = {
+            &atrousSmoothAxisKernel<RuntimeTaps>,
+            &atrousSmoothAxisKernel<B3SplineTaps>,
+            &atrousSmoothAxisKernel<TriangleTaps>,
+            &atrousSmoothAxisKernel<HaarTaps>
+        };
+        kernels[filterTapsIndex(par.filter())](input, output, mask, size, dim, stride, spacing, par);
+    }
+
+    float findMeanByChannel(float *array, std::vector<bool> &mask, size_t spatialSize,
+            size_t zdim, int numThreads)
+    {
+        ///  Find the mean of the masked pixels of a cube. The sums are
+        ///   accumulated separately for each channel (in parallel
+        ///   when numThreads>1) and then added together in channel
+        ///   order, so the result does not depend on the number of
+        ///   threads used. It differs from findMean() only by the
+        ///   rounding of the double-precision sums.
+        ///
+        ///  \param array The cube of values.
+        ///  \param mask Which pixels of the cube to include.
+        ///  \param spatialSize The number of pixels in each channel.
+        ///  \param zdim The number of channels.
+        ///  \param numThreads The number of threads to use.
+        ///  \return The mean of the masked pixels.
+
+        std::vector<double> sum(zdim,0.);
+        std::vector<size_t> count(zdim,0);
+#pragma omp parallel for schedule(static) num_threads(numThreads)
+        for(long z=0; z<long(zdim); z++){
+            for(size_t pos=z*spatialSize; pos<(z+1)*spatialSize; pos++){
+                if(mask[pos]){
+                    sum[z] += double(array[pos]);
+                    count[z]++;
+                }
             }
-            if (d >= dim) {
-                d = 2*(dim-1) - d;
+        }
+
+        double total=0.;
+        size_t ct=0;
+        for(size_t z=0; z<zdim; z++){
+            total += sum[z];
+            ct += count[z];
+        }
+        if(ct>0) total /= double(ct);
+        return float(total);
+    }
+
+    float findStddevDiffByChannel(float *first, float *second, std::vector<bool> &mask,
+            size_t spatialSize, size_t zdim, int numThreads)
+    {
+        ///  Find the standard deviation of the difference between two
+        ///   cubes, over the masked pixels. As for
+        ///   findMeanByChannel(), the sums of x and x^2 are found for
+        ///   each channel in parallel and then combined in channel
+        ///   order, so the result is independent of the number of
+        ///   threads and agrees with findStddevDiff() to within
+        ///   double-precision rounding.
+        ///
+        ///  \param first The first cube.
+        ///  \param second The cube to be subtracted from the first.
+        ///  \param mask Which pixels of the cube to include.
+        ///  \param spatialSize The number of pixels in each channel.
+        ///  \param zdim The number of channels.
+        ///  \param numThreads The number of threads to use.
+        ///  \return The standard deviation of first-second.
+
+        std::vector<double> sumx(zdim,0.),sumxx(zdim,0.);
+        std::vector<size_t> count(zdim,0);
+#pragma omp parallel for schedule(static) num_threads(numThreads)
+        for(long z=0; z<long(zdim); z++){
+            for(size_t pos=z*spatialSize; pos<(z+1)*spatialSize; pos++){
+                if(mask[pos]){
+                    float diff = first[pos]-second[pos];
+                    sumx[z] += diff;
+                    sumxx[z] += diff*diff;
+                    count[z]++;
+                }
             }
         }
+
+        double totalx=0.,totalxx=0.;
+        size_t ct=0;
+        for(size_t z=0; z<zdim; z++){
+            totalx += sumx[z];
+            totalxx += sumxx[z];
+            ct += count[z];
+        }
+        double stddev=0.;
+        if(ct>0){
+            double mean = totalx/double(ct);
+            stddev = sqrt(totalxx/double(ct) - mean*mean);
+        }
+        return float(stddev);
+    }
+
+    float findStddevDiffByChannel(float *first, float *second, Param &par,
+            size_t spatialSize, size_t zdim)
+    {
+        ///  As for the version above, but without a mask array: the
+        ///   pixels used are those of the first cube that are not
+        ///   BLANK. This gives the same result as the masked version
+        ///   when the mask is the non-BLANK pixels of the first cube.
+        ///
+        ///  \param first The first cube.
+        ///  \param second The cube to be subtracted from the first.
+        ///  \param par The Param set, used to test for BLANK pixels
+        ///  and holding the number of threads to use.
+        ///  \param spatialSize The number of pixels in each channel.
+        ///  \param zdim The number of channels.
+        ///  \return The standard deviation of first-second.
+
+        std::vector<double> sumx(zdim,0.),sumxx(zdim,0.);
+        std::vector<size_t> count(zdim,0);
+#pragma omp parallel for schedule(static) num_threads(par.getNumThreads())
+        for(long z=0; z<long(zdim); z++){
+            for(size_t pos=z*spatialSize; pos<(z+1)*spatialSize; pos++){
+                if(!par.isBlank(first[pos])){
+                    float diff = first[pos]-second[pos];
+                    sumx[z] += diff;
+                    sumxx[z] += diff*diff;
+                    count[z]++;
+                }
+            }
+        }
+
+        double totalx=0.,totalxx=0.;
+        size_t ct=0;
+        for(size_t z=0; z<zdim; z++){
+            totalx += sumx[z];
+            totalxx += sumxx[z];
+            ct += count[z];
+        }
+        double stddev=0.;
+        if(ct>0){
+            double mean = totalx/double(ct);
+            stddev = sqrt(totalxx/double(ct) - mean*mean);
+        }
+        return float(stddev);
+    }
+
+    float findMADFMDiffStreaming(float *first, float *second, Param &par, size_t size,
+            size_t capacity)
+    {
+        ///  Find the median absolute deviation from the median of the
+        ///   difference between two cubes, over the non-BLANK pixels
+        ///   of the first, without making a copy of the cubes. The
+        ///   median is found with a StreamingMedian, which makes
+        ///   several passes through the arrays but only stores a
+        ///   limited number of values. The result is the same as
+        ///   findMADFMDiff() would give.
+        ///
+        ///  \param first The first cube.
+        ///  \param second The cube to be subtracted from the first.
+        ///  \param par The Param set, used to test for BLANK pixels.
+        ///  \param size The number of pixels in the cubes.
+        ///  \param capacity The largest number of values to store.
+        ///  \return The MADFM of first-second.
+
+        Statistics::StreamingMedian findMed(capacity);
+        while(findMed.needsPass()){
+            findMed.startPass();
+            for(size_t pos=0;pos<size;pos++)
+                if(!par.isBlank(first[pos])) findMed.add(first[pos]-second[pos]);
+            findMed.endPass();
+        }
+        float median = findMed.getMedian();
+
+        Statistics::StreamingMedian findMadfm(capacity);
+        while(findMadfm.needsPass()){
+            findMadfm.startPass();
+            for(size_t pos=0;pos<size;pos++)
+                if(!par.isBlank(first[pos])) findMadfm.add(absval(first[pos]-second[pos]-median));
+            findMadfm.endPass();
+        }
+        return findMadfm.getMedian();
+    }
+
+    /// @brief
+    ///  Find the wavelet coefficients of a cube one channel at a time.
+    /// @details
+    ///  At a given scale, the wavelet coefficients of channel z are the
+    ///  coefficients from the previous scale minus their 3D
+    ///  convolution with the filter. The convolution is done as for
+    ///  the full cube: the x and y passes are made on each channel
+    ///  that is needed, and the z pass combines filterwidth of these
+    ///  convolved channels. The convolved channels are cached, and a
+    ///  channel is only dropped from the cache when no later channel
+    ///  will need it.
+    ///
+    ///  The caching means the coefficients of a channel can be
+    ///  overwritten with those of the next scale as soon as its
+    ///  wavelet coefficients have been used: every channel that needs
+    ///  it will use the cached convolved version. The channels are
+    ///  visited in groups that are spaced by the filter spacing (and
+    ///  the groups that are linked by the reflections at the ends of
+    ///  the cube are visited one after the other), so that only a few
+    ///  channels need to be in the cache at any time, even at the
+    ///  largest scales.
+
+    class WaveletPlaneSweep
+    {
+    public:
+        WaveletPlaneSweep(size_t xdim, size_t ydim, size_t zdim, float *input, float *coeffs, Param &par);
+        virtual ~WaveletPlaneSweep();
+
+        /// @brief Set up a sweep through the cube at the given filter spacing.
+        void   start(int spacing);
+        /// @brief Move to the next channel, finding its wavelet coefficients. Returns false when all channels have been done.
+        bool   next();
+        /// @brief The current channel.
+        size_t channel(){return order[step];};
+        /// @brief The wavelet coefficients of the current channel (zero for BLANK pixels).
+        float *wavelet(){return waveletPlane;};
+        /// @brief Which pixels of the current channel are not BLANK.
+        std::vector<bool> &isGood(){return goodPlane;};
+        /// @brief The largest number of convolved channels held at once in the current sweep.
+        size_t peakPlanes(){return peak;};
+
+    private:
+        float *convolvedPlane(size_t z);
+        void   releasePlane(size_t z);
+
+        size_t xdim;
+        size_t ydim;
+        size_t zdim;
+        size_t spatialSize;
+        float *input;
+        float *coeffs;
+        Param &par;
+        int    filterwidth;
+        int    filterHW;
+        std::vector<double> filter;
+        int    spacing;
+        long   step;
+        size_t peak;
+        std::vector<size_t> order;     ///< The order in which the channels are visited.
+        std::vector<size_t> taps;      ///< The channels used in the z-convolution of each channel.
+        std::vector<long>   lastUse;   ///< The last step at which each convolved channel is needed.
+        std::vector<float*> cache;     ///< The convolved channels, indexed by channel number.
+        std::vector<float*> spare;     ///< Buffers that are not currently in use.
+        std::vector<float*> tapPlane;
+        std::vector<bool>   goodPlane;
+        std::vector<bool>   maskPlane;
+        float *workPlane;
+        float *waveletPlane;
+    };
+
+    WaveletPlaneSweep::WaveletPlaneSweep(size_t xdim, size_t ydim, size_t zdim, float *input,
+            float *coeffs, Param &par):
+        par(par)
+    {
+        ///  \param xdim The length of the x-axis.
+        ///  \param ydim The length of the y-axis.
+        ///  \param zdim The length of the z-axis.
+        ///  \param input The input cube, used to find the BLANK pixels.
+        ///  \param coeffs The coefficients from the previous scale.
+        ///  \param par The Param set, holding the filter.
+
+        this->xdim = xdim;
+        this->ydim = ydim;
+        this->zdim = zdim;
+        this->spatialSize = xdim*ydim;
+        this->input = input;
+        this->coeffs = coeffs;
+        this->filterwidth = par.filter().width();
+        this->filterHW = this->filterwidth/2;
+        this->filter.resize(this->filterwidth);
+        for(int i=0;i<this->filterwidth;i++) this->filter[i] = par.filter().coeff(i);
+        this->spacing = 0;
+        this->step = -1;
+        this->peak = 0;
+        this->cache = std::vector<float*>(zdim,(float*)0);
+        this->tapPlane.resize(this->filterwidth);
+        this->goodPlane.resize(this->spatialSize);
+        this->maskPlane.resize(this->spatialSize);
+        this->workPlane = new float[this->spatialSize];
+        this->waveletPlane = new float[this->spatialSize];
+    }
+
+    WaveletPlaneSweep::~WaveletPlaneSweep()
+    {
+        for(size_t z=0;z<this->zdim;z++) if(this->cache[z]) delete [] this->cache[z];
+        for(size_t i=0;i<this->spare.size();i++) delete [] this->spare[i];
+        delete [] this->workPlane;
+        delete [] this->waveletPlane;
+    }
+
+    void WaveletPlaneSweep::start(int spacing)
+    {
+        ///  Work out the order in which to visit the channels, and
+        ///   when each convolved channel is last needed.
+        ///  \param spacing The separation of the filter taps.
+
+        for(size_t z=0;z<this->zdim;z++) if(this->cache[z]) this->releasePlane(z);
+        this->spacing = spacing;
+        this->step = -1;
+
+        findFilterTaps(this->zdim, this->filterwidth, spacing, 1, this->taps);
+
+        // Channels that are a multiple of the spacing apart only
+        // need each other, apart from where the reflections at the
+        // ends link one group to another. Link the groups...
+        size_t numGroups = std::min(size_t(spacing), this->zdim);
+        std::vector<std::vector<size_t> > linked(numGroups);
+        for(size_t i=0;i<this->taps.size();i++){
+            size_t a = (i/this->filterwidth) % spacing;
+            size_t b = this->taps[i] % spacing;
+            if(a!=b && std::find(linked[a].begin(),linked[a].end(),b)==linked[a].end()){
+                linked[a].push_back(b);
+                linked[b].push_back(a);
+            }
+        }
+        // ...and follow the chains of linked groups, starting at the
+        // ends of chains where possible.
+        this->order.clear();
+        std::vector<bool> done(numGroups,false);
+        for(int pass=0;pass<2;pass++){
+            for(size_t g=0;g<numGroups;g++){
+                if(done[g] || (pass==0 && linked[g].size()>1)) continue;
+                size_t group = g;
+                bool more = true;
+                while(more){
+                    done[group] = true;
+                    for(size_t z=group;z<this->zdim;z+=spacing) this->order.push_back(z);
+                    more = false;
+                    for(size_t i=0;i<linked[group].size() && !more;i++){
+                        if(!done[linked[group][i]]){
+                            group = linked[group][i];
+                            more = true;
+                        }
+                    }
+                }
+            }
+        }
+
+        // When is each convolved channel first and last needed?
+        std::vector<long> firstUse(this->zdim,-1);
+        this->lastUse.assign(this->zdim,-1);
+        for(size_t t=0;t<this->zdim;t++){
+            size_t z = this->order[t];
+            for(int f=0;f<this->filterwidth;f++){
+                size_t q = this->taps[z*this->filterwidth+f];
+                if(firstUse[q]<0) firstUse[q] = t;
+                this->lastUse[q] = t;
+            }
+        }
+        std::vector<long> change(this->zdim+1,0);
+        for(size_t z=0;z<this->zdim;z++){
+            change[firstUse[z]]++;
+            change[this->lastUse[z]+1]--;
+        }
+        long live=0;
+        this->peak = 0;
+        for(size_t t=0;t<this->zdim;t++){
+            live += change[t];
+            this->peak = std::max(this->peak, size_t(live));
+        }
+    }
+
+    float *WaveletPlaneSweep::convolvedPlane(size_t z)
+    {
+        ///  Return channel z of the coefficient cube convolved in x
+        ///   and y, finding it if it is not already in the cache.
+
+        if(this->cache[z]==0){
+            float *plane;
+            if(this->spare.size()>0){
+                plane = this->spare.back();
+                this->spare.pop_back();
+            }
+            else plane = new float[this->spatialSize];
+            float *chan = this->input + z*this->spatialSize;
+            for(size_t pos=0;pos<this->spatialSize;pos++) this->maskPlane[pos] = !this->par.isBlank(chan[pos]);
+            atrousSmoothAxis(this->coeffs+z*this->spatialSize, this->workPlane, &this->maskPlane,
+                    this->spatialSize, this->xdim, 1, this->spacing, this->par);
+            atrousSmoothAxis(this->workPlane, plane, 0, this->spatialSize, this->ydim, this->xdim,
+                    this->spacing, this->par);
+            this->cache[z] = plane;
+        }
+        return this->cache[z];
+    }
+
+    void WaveletPlaneSweep::releasePlane(size_t z)
+    {
+        this->spare.push_back(this->cache[z]);
+        this->cache[z] = 0;
+    }
+
+    bool WaveletPlaneSweep::next()
+    {
+        ///  Drop the convolved channels that are no longer needed,
+        ///   then find the wavelet coefficients of the next channel
+        ///   in the sweep. The z-convolution is done in the same way
+        ///   as atrousSmoothAxis(), so the coefficients are identical
+        ///   to those found for the full cube.
+
+        if(this->step>=0){
+            size_t z = this->order[this->step];
+            for(int f=0;f<this->filterwidth;f++){
+                size_t q = this->taps[z*this->filterwidth+f];
+                if(this->lastUse[q]==this->step && this->cache[q]) this->releasePlane(q);
+            }
+        }
+        this->step++;
+        if(this->step >= long(this->zdim)) return false;
+
+        size_t z = this->order[this->step];
+        float *chan = this->input + z*this->spatialSize;
+        float *coeffChan = this->coeffs + z*this->spatialSize;
+        for(size_t pos=0;pos<this->spatialSize;pos++) this->goodPlane[pos] = !this->par.isBlank(chan[pos]);
+        for(int f=0;f<this->filterwidth;f++)
+            this->tapPlane[f] = this->convolvedPlane(this->taps[z*this->filterwidth+f]);
+
+#pragma omp parallel for schedule(static) num_threads(this->par.getNumThreads())
+        for(long pos=0;pos<long(this->spatialSize);pos++){
+            if(this->goodPlane[pos]){
+                double sum=0.;
+                for(int f=0;f<this->filterwidth;f++)
+                    sum += this->filter[f] * this->tapPlane[f][pos];
+                float smoothed = sum;
+                this->waveletPlane[pos] = coeffChan[pos] - smoothed;
+            }
+            else this->waveletPlane[pos] = 0.;
+        }
+
+        return true;
+    }
+
+    void atrous3DReconstructByPlane(size_t xdim, size_t ydim, size_t zdim, float *input,
+            float *output, Param &par)
+    {
+        ///  A version of atrous3DReconstruct() for cubes that are too
+        ///   large for its work arrays to fit in the memory budget
+        ///   given by par.getReconMemory(). Rather than holding the
+        ///   wavelet coefficients and the convolved array for the
+        ///   whole cube, the coefficients are found a channel at a
+        ///   time using a WaveletPlaneSweep, and are added to the
+        ///   output (and removed from the coefficient array) straight
+        ///   away. Only one cube-sized work array (the coefficients
+        ///   carried from one scale to the next) is needed, along
+        ///   with a few channel maps, and no mask array is kept --
+        ///   BLANK pixels are found from the input as needed.
+        ///
+        ///  The threshold at each scale depends on the mean (or
+        ///   median) of the wavelet coefficients over the whole cube,
+        ///   so each scale needs a sweep to find this before the sweep
+        ///   that applies the threshold. The mean is built from the
+        ///   partial sums of each channel, combined in channel order
+        ///   as in findMeanByChannel(). The medians (and the MADFM
+        ///   values used for the noise) are found with a
+        ///   StreamingMedian, which needs a few sweeps but gives the
+        ///   exact value. The result is therefore the same as that
+        ///   of atrous3DReconstruct(), at the cost of more
+        ///   convolutions.
+        ///
+        ///  \param xdim The length of the x-axis.
+        ///  \param ydim The length of the y-axis.
+        ///  \param zdim The length of the z-axis.
+        ///  \param input The input cube.
+        ///  \param output The returned reconstructed cube. This array needs to be declared beforehand.
+        ///  \param par The Param set. The value of scaleMax should
+        ///  already have been checked.
+
+        const float SNR_THRESH=par.getAtrousCut();
+        unsigned int MIN_SCALE=par.getMinScale();
+        unsigned int MAX_SCALE=par.getMaxScale();
+
+        size_t size = xdim * ydim * zdim;
+        size_t spatialSize = xdim * ydim;
+        size_t mindim = xdim;
+        if (ydim<mindim) mindim = ydim;
+        if (zdim<mindim) mindim = zdim;
+        unsigned int numScales = par.filter().getNumScales(mindim);
+
+        double *sigmaFactors = new double[numScales+1];
+        for(size_t i=0;i<=numScales;i++){
+            if(i<=size_t(par.filter().maxFactor(3)) )
+                sigmaFactors[i] = par.filter().sigmaFactor(3,i);
+            else sigmaFactors[i] = sigmaFactors[i-1] / sqrt(8.);
+        }
+
+        // The wavelet coefficients are bounded by the size of the
+        // coefficients they come from, which gives the range for the
+        // streaming median.
+        double filterSum=0.;
+        for(unsigned int i=0;i<par.filter().width();i++) filterSum += fabs(par.filter().coeff(i));
+        double waveletBound = (1. + filterSum*filterSum*filterSum) * (1.+1.e-6);
+
+        size_t goodSize=0;
+        for(size_t pos=0;pos<size;pos++)
+            if(!par.isBlank(input[pos])) goodSize++;
+
+        if(goodSize == 0){
+            for(size_t pos=0;pos<size; pos++) output[pos] = input[pos];
+            DUCHAMPWARN("3D Reconstruction", "There are no good pixels to be reconstructed -- all are BLANK. Returning input array.\n");
+            delete [] sigmaFactors;
+            return;
+        }
+
+        float *coeffs = new float[size];
+        WaveletPlaneSweep sweep(xdim,ydim,zdim,input,coeffs,par);
+
+        // Work out how much of the budget is left for the streaming
+        // medians, once the arrays and the channel maps are allowed for.
+        double budget = par.getReconMemory() * 1024. * 1024.;
+        size_t maxPlanes=0;
+        for(unsigned int scale=1, spacing=1; scale<=numScales; scale++, spacing*=2){
+            sweep.start(spacing);
+            maxPlanes = std::max(maxPlanes, sweep.peakPlanes());
+        }
+        double needed = double(size)*3.*sizeof(float) + double(maxPlanes+2)*spatialSize*sizeof(float);
+        size_t capacity = 1048576;
+        if(par.getFlagRobustStats()) needed += Statistics::StreamingMedian::memoryUsage(capacity);
+        if(needed > budget){
+            DUCHAMPWARN("3D Reconstruction", "The reconstruction needs at least " << needed/1024./1024. << "MB (including the input and output arrays), which is more than the reconMemory value of " << par.getReconMemory() << "MB. Continuing anyway.");
+        }
+        else if(par.getFlagRobustStats())
+            capacity += size_t((budget-needed)/sizeof(float));
+        capacity = std::min(capacity, goodSize);
+
+        float originalSigma,oldsigma,newsigma,mean=0.,threshold=0.;
+        for(size_t pos=0;pos<size;pos++) output[pos]=0.;
+        if(par.getFlagRobustStats())
+            originalSigma = madfmToSigma(findMADFMDiffStreaming(input,output,par,size,capacity));
+        else
+            originalSigma = findStddevDiffByChannel(input,output,par,spatialSize,zdim);
+
+        std::vector<double> chanSum(zdim);
+        std::vector<size_t> chanCount(zdim);
+        int iteration=0;
+        newsigma = 1.e9;
+        do{
+            if(par.isVerbose()) std::cout << "Iteration #"<<setw(2)<<++iteration<<": ";
+            oldsigma = newsigma;
+            float maxCoeff=0.;
+#pragma omp parallel for num_threads(par.getNumThreads()) reduction(max:maxCoeff)
+            for(long i=0;i<long(size);i++){
+                coeffs[i] = input[i] - output[i];
+                if(!par.isBlank(input[i]) && fabs(coeffs[i])>maxCoeff) maxCoeff = fabs(coeffs[i]);
+            }
+
+            int spacing = 1;
+            for(unsigned int scale = 1; scale<=numScales; scale++){
+
+                if(par.isVerbose()){
+                    std::cout << "Scale ";
+                    std::cout << setw(2)<<scale<<" / "<<setw(2)<<numScales;
+                    printBackSpace(std::cout,13);
+                    std::cout << std::flush;
+                }
+
+                bool useScale = (scale>=MIN_SCALE && scale <=MAX_SCALE);
+                if(useScale){
+                    // First sweep(s): find the mean or median of the
+                    // wavelet coefficients at this scale.
+                    if(par.getFlagRobustStats()){
+                        Statistics::StreamingMedian findMed(capacity);
+                        findMed.setRange(-waveletBound*maxCoeff, waveletBound*maxCoeff);
+                        while(findMed.needsPass()){
+                            findMed.startPass();
+                            sweep.start(spacing);
+                            while(sweep.next()){
+                                float *wavelet = sweep.wavelet();
+                                std::vector<bool> &isGood = sweep.isGood();
+                                for(size_t pos=0;pos<spatialSize;pos++)
+                                    if(isGood[pos]) findMed.add(wavelet[pos]);
+                            }
+                            findMed.endPass();
+                        }
+                        mean = findMed.getMedian();
+                    }
+                    else{
+                        sweep.start(spacing);
+                        while(sweep.next()){
+                            size_t z = sweep.channel();
+                            float *wavelet = sweep.wavelet();
+                            std::vector<bool> &isGood = sweep.isGood();
+                            chanSum[z] = 0.;
+                            chanCount[z] = 0;
+                            for(size_t pos=0;pos<spatialSize;pos++){
+                                if(isGood[pos]){
+                                    chanSum[z] += double(wavelet[pos]);
+                                    chanCount[z]++;
+                                }
+                            }
+                        }
+                        double total=0.;
+                        size_t ct=0;
+                        for(size_t z=0; z<zdim; z++){
+                            total += chanSum[z];
+                            ct += chanCount[z];
+                        }
+                        if(ct>0) total /= double(ct);
+                        mean = float(total);
+                    }
+                    threshold = mean + SNR_THRESH*originalSigma*sigmaFactors[scale];
+                }
+
+                // Final sweep: threshold the wavelet coefficients,
+                // and move on to the coefficients for the next scale.
+                float nextMax=0.;
+                sweep.start(spacing);
+                while(sweep.next()){
+                    size_t offset = sweep.channel()*spatialSize;
+                    float *wavelet = sweep.wavelet();
+                    std::vector<bool> &isGood = sweep.isGood();
+#pragma omp parallel for num_threads(par.getNumThreads()) reduction(max:nextMax)
+                    for(long pos=0;pos<long(spatialSize);pos++){
+                        size_t i = offset + pos;
+                        if(useScale){
+                            if(!isGood[pos]) output[i] = input[i];
+                            else if( fabs(wavelet[pos]) > threshold ) output[i] += wavelet[pos];
+                        }
+                        coeffs[i] = coeffs[i] - wavelet[pos];
+                        if(isGood[pos] && fabs(coeffs[i])>nextMax) nextMax = fabs(coeffs[i]);
+                    }
+                }
+                maxCoeff = nextMax;
+
+                spacing *= 2;
+
+            } //-> end of scale loop
+
+#pragma omp parallel for num_threads(par.getNumThreads())
+            for(long pos=0;pos<long(size);pos++)
+                if(!par.isBlank(input[pos])) output[pos] += coeffs[pos];
+
+            if(par.getFlagRobustStats())
+                newsigma = madfmToSigma(findMADFMDiffStreaming(input,output,par,size,capacity));
+            else
+                newsigma = findStddevDiffByChannel(input,output,par,spatialSize,zdim);
+
+            if(par.isVerbose()) printBackSpace(std::cout,15);
+
+        } while( (iteration==1) || 
+                (fabs(oldsigma-newsigma)/newsigma > par.getReconConvergence()) );
+
+        if(par.isVerbose()) std::cout << "Completed "<<iteration<<" iterations. ";
+
+        delete [] coeffs;
+        delete [] sigmaFactors;
     }
 
     void atrous3DReconstruct(size_t &xdim, size_t &ydim, size_t &zdim, float *&input, 
@@ -71,6 +860,17 @@ namespace duchamp
         ///  \param input The input spectrum.
         ///  \param output The returned reconstructed spectrum. This array needs to be declared beforehand.
         ///  \param par The Param set.
+        ///
+        ///  The convolutions, the pixel-by-pixel operations and the
+        ///  mean & standard deviation calculations are shared between
+        ///  par.getNumThreads() threads (if compiled with OpenMP). The
+        ///  result does not depend on the number of threads. The
+        ///  robust (median-based) statistics are still calculated
+        ///  serially.
+        ///
+        ///  If par.getReconMemory() is set and the work arrays would
+        ///  need more memory than that, atrous3DReconstructByPlane() is
+        ///  used instead.
 
         const float SNR_THRESH=par.getAtrousCut();
         unsigned int MIN_SCALE=par.getMinScale();
@@ -78,6 +878,7 @@ namespace duchamp
 
         size_t size = xdim * ydim * zdim;
         size_t spatialSize = xdim * ydim;
+        int numThreads = par.getNumThreads();
         size_t mindim = xdim;
         if (ydim<mindim) mindim = ydim;
         if (zdim<mindim) mindim = zdim;
@@ -92,6 +893,19 @@ namespace duchamp
             par.setMaxScale(MAX_SCALE);
         }
 
+        // The input and output arrays, plus the work arrays below and
+        // the mask, take a little over five times the size of the
+        // cube. If that is more than the memory budget, work through
+        // the cube by channel instead.
+        if(par.getReconMemory()>0.){
+            double needed = double(size) * (5.*sizeof(float) + 1./8.);
+            if(needed > par.getReconMemory()*1024.*1024.){
+                if(par.isVerbose()) std::cout << "Reconstructing by channel to save memory. ";
+                atrous3DReconstructByPlane(xdim,ydim,zdim,input,output,par);
+                return;
+            }
+        }
+
         double *sigmaFactors = new double[numScales+1];
         for(size_t i=0;i<=numScales;i++){
             if(i<=size_t(par.filter().maxFactor(3)) )
@@ -121,9 +935,12 @@ namespace duchamp
 
             // findMedianStats(input,goodSize,isGood,originalMean,originalSigma);
             if(par.getFlagRobustStats())
-                originalSigma = madfmToSigma(findMADFM(input,isGood,size));
-            else
-                originalSigma = findStddev<float>(input,isGood,size);
+                originalSigma = madfmToSigma(Statistics::findMADFMStreaming(input,isGood,size));
+            else{
+                // the stddev of input is that of the difference from a zero array
+                for(size_t pos=0;pos<size;pos++) output[pos]=0.;
+                originalSigma = findStddevDiffByChannel(input,output,isGood,spatialSize,zdim,numThreads);
+            }
 
             float *coeffs = new float[size];
             float *wavelet = new float[size];
@@ -131,29 +948,22 @@ namespace duchamp
 
             for(size_t pos=0;pos<size;pos++) output[pos]=0.;
 
-            // Define the 3-D (separable) filter, using info from par.filter()
-            size_t filterwidth = par.filter().width();
-            int filterHW = filterwidth/2;
-            size_t fsize = filterwidth*filterwidth*filterwidth;
-            double *filter = new double[fsize];
-            for(size_t i=0;i<filterwidth;i++){
-                for(size_t j=0;j<filterwidth;j++){
-                    for(size_t k=0;k<filterwidth;k++){
-                        filter[i +j*filterwidth + k*filterwidth*filterwidth] = 
-                            par.filter().coeff(i) * par.filter().coeff(j) * par.filter().coeff(k);
-                    }
-                }
-            }
+            // The 3-D filter is separable, so the convolution is done
+            // as three 1-D passes, one along each axis. This needs an
+            // extra array to hold the intermediate result.
+            float *smoothed = new float[size];
 
             float threshold;
             int iteration=0;
             newsigma = 1.e9;
+#pragma omp parallel for num_threads(numThreads)
             for(size_t i=0;i<size;i++) output[i] = 0;
             do{
                 if(par.isVerbose()) std::cout << "Iteration #"<<setw(2)<<++iteration<<": ";
                 // first, get the value of oldsigma, set it to the previous newsigma value
                 oldsigma = newsigma;
                 // we are transforming the residual array (input array first time around)
+#pragma omp parallel for num_threads(numThreads)
                 for(size_t i=0;i<size;i++)  coeffs[i] = input[i] - output[i];
 
                 int spacing = 1;
@@ -166,64 +976,29 @@ namespace duchamp
                         std::cout << std::flush;
                     }
 
-                    size_t pos = 0;
-                    for(unsigned long zpos = 0; zpos<zdim; zpos++){
-                        for(unsigned long ypos = 0; ypos<ydim; ypos++){
-                            for(unsigned long xpos = 0; xpos<xdim; xpos++){
-                                // loops over each pixel in the image
-
-                                wavelet[pos] = coeffs[pos];
-
-                                if(!isGood[pos] )  wavelet[pos] = 0.;
-                                else{
-
-                                    // XXX CONVOLUTION
-                                    unsigned int filterpos = 0;
-                                    for(int zoffset=-filterHW; zoffset<=filterHW; zoffset++){
-                                        long z = zpos + spacing*zoffset;
-                                        boundaryConditions(z, zdim);
-                                        size_t oldchan = z * spatialSize;
-
-                                        for(int yoffset=-filterHW; yoffset<=filterHW; yoffset++){
-                                            long y = long(ypos) + spacing*yoffset;
-                                            // REFLECT
-                                            boundaryConditions(y, ydim);
-                                            size_t oldrow = y * xdim;
-
-                                            for(int xoffset=-filterHW; xoffset<=filterHW; xoffset++){
-                                                long x = long(xpos) + spacing*xoffset;
-                                                boundaryConditions(x, xdim);
-
-                                                size_t oldpos = oldchan + oldrow + x;
-
-                                                if(isGood[oldpos]) 
-                                                    wavelet[pos] -= filter[filterpos]*coeffs[oldpos];
-
-                                                filterpos++;
-
-                                            } //-> end of xoffset loop
-                                        } //-> end of yoffset loop
-                                    } //-> end of zoffset loop
-                                } //-> end of else{ ( from if(!isGood[pos])  )
-
-                                pos++;
-                            } //-> end of xpos loop
-                            } //-> end of ypos loop
-                        } //-> end of zpos loop
+                    atrousSmoothAxis(coeffs, wavelet, &isGood, size, xdim, 1, spacing, par);
+                    atrousSmoothAxis(wavelet, smoothed, 0, size, ydim, xdim, spacing, par);
+                    atrousSmoothAxis(smoothed, wavelet, 0, size, zdim, spatialSize, spacing, par);
 
+#pragma omp parallel for num_threads(numThreads)
+                    for(size_t pos=0;pos<size;pos++){
+                        if(isGood[pos]) wavelet[pos] = coeffs[pos] - wavelet[pos];
+                        else wavelet[pos] = 0.;
                         // Need to do this after we've done *all* the convolving
-                        for(size_t pos=0;pos<size;pos++) coeffs[pos] = coeffs[pos] - wavelet[pos];
+                        coeffs[pos] = coeffs[pos] - wavelet[pos];
+                    }
 
                         // Have found wavelet coeffs for this scale -- now threshold
                         if(scale>=MIN_SCALE && scale <=MAX_SCALE){
                             if(par.getFlagRobustStats())
                                 // findMedianStats(wavelet,size,isGood,mean,sigma);
-                                mean = findMedian<float>(wavelet,isGood,size);
+                                mean = Statistics::findMedianStreaming(wavelet,isGood,size);
                             else
                                 //findNormalStats(wavelet,size,isGood,mean,sigma);
-                                mean = findMean<float>(wavelet,isGood,size);
+                                mean = findMeanByChannel(wavelet,isGood,spatialSize,zdim,numThreads);
 
                             threshold = mean + SNR_THRESH*originalSigma*sigmaFactors[scale];
+#pragma omp parallel for num_threads(numThreads)
                             for(size_t pos=0;pos<size;pos++){
                                 if(!isGood[pos]){
                                     output[pos] = input[pos]; 
@@ -240,6 +1015,7 @@ namespace duchamp
 
                     } //-> end of scale loop 
 
+#pragma omp parallel for num_threads(numThreads)
                     for(size_t pos=0;pos<size;pos++) {
                         if(isGood[pos]) {
                             output[pos] += coeffs[pos];
@@ -251,9 +1027,9 @@ namespace duchamp
                     // findMedianStatsDiff(input,output,goodSize,isGood,mean,newsigma);
                     // newsigma = madfmToSigma(newsigma);
                     if(par.getFlagRobustStats())
-                        newsigma = madfmToSigma(findMADFMDiff(input,output,isGood,size));
+                        newsigma = madfmToSigma(Statistics::findMADFMDiffStreaming(input,output,isGood,size));
                     else
-                        newsigma = findStddevDiff<float>(input,output,isGood,size);
+                        newsigma = findStddevDiffByChannel(input,output,isGood,spatialSize,zdim,numThreads);
 
                     if(par.isVerbose()) printBackSpace(std::cout,15);
 
@@ -266,7 +1042,7 @@ namespace duchamp
                 // delete [] xLim2;
                 // delete [] yLim1;
                 // delete [] yLim2;
-                delete [] filter;
+                delete [] smoothed;
                 // delete [] residual;
                 delete [] coeffs;
                 delete [] wavelet;
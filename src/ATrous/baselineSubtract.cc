@@ -27,6 +27,7 @@
 // -----------------------------------------------------------------------
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include <math.h>
 #include <duchamp/param.hh>
 #include <duchamp/ATrous/filter.hh>
@@ -51,8 +52,6 @@ namespace duchamp
     /// \param par The Param set: information on BLANK values and on how
     ///            the subtraction is done.
 
-    float *spec     = new float[specLength];
-    float *thisBaseline = new float[specLength];
     int minscale = par.getMinScale();
     par.setMinScale(par.filter().getNumScales(specLength));
     float atrouscut = par.getAtrousCut();
@@ -62,20 +61,20 @@ namespace duchamp
 
     ProgressBar bar;
     if(flagVerb) bar.init(numSpec);
-    for(size_t pix=0; pix<numSpec; pix++){ // for each spatial pixel...
+    // Reconstruct the spectra of adjacent pixels in batches, reading
+    // each channel of a batch as a contiguous run.
+    for(size_t pix=0; pix<numSpec; pix+=atrousBatchSize){
 
-      if(flagVerb) bar.update(pix+1);
+      size_t batchSize = std::min(atrousBatchSize, numSpec-pix);
+      if(flagVerb) bar.update(pix+batchSize);
 
-      for(size_t z=0; z<specLength; z++) 
-	spec[z] = originalCube[z*numSpec + pix];
-
-      atrous1DReconstruct(specLength,spec,thisBaseline,par);
+      atrous1DReconstructBatch(specLength,batchSize,numSpec,originalCube+pix,baselineValues+pix,par);
 
       for(size_t z=0; z<specLength; z++) {
-	baselineValues[z*numSpec+pix] = thisBaseline[z];
-	if(!par.isBlank(originalCube[z*numSpec+pix])) 
-	  originalCube[z*numSpec+pix] = originalCube[z*numSpec+pix] - 
-	    baselineValues[z*numSpec+pix];
+	for(size_t i=z*numSpec+pix; i<z*numSpec+pix+batchSize; i++){
+	  if(!par.isBlank(originalCube[i])) 
+	    originalCube[i] = originalCube[i] - baselineValues[i];
+	}
       }
 
     }    
@@ -85,9 +84,6 @@ namespace duchamp
     par.setAtrousCut(atrouscut);
     par.setVerbosity(flagVerb);
   
-    delete [] spec;
-    delete [] thisBaseline;
-    
   }
 
   void findAtrousBaseline(size_t size, float *input, float *baseline, Param &par)
@@ -173,4 +169,64 @@ namespace duchamp
 
   }
 
+  void findAtrousBaseline(size_t size, size_t numSpec, size_t stride, float *input, float *baseline, Param &par)
+  {
+    ///   A version of findAtrousBaseline() that does a batch of
+    ///     spectra at once, using atrous1DReconstructBatch(). The
+    ///     spectra are interleaved: channel z of spectrum b is at
+    ///     input[z*stride+b] (so for a cube, use numSpec adjacent
+    ///     pixels and stride=xdim*ydim). Each spectrum is trimmed at
+    ///     5*MADFM above its own median before reconstruction, as
+    ///     for the single-spectrum version, and the results are the
+    ///     same as doing each spectrum individually.
+    ///  \param size Length of each spectrum.
+    ///  \param numSpec Number of spectra in the batch.
+    ///  \param stride The separation in the arrays between successive
+    ///   channels of a spectrum.
+    ///  \param input The input array : this is not affected.
+    ///  \param baseline The returned baseline array, in the same layout
+    ///   as the input. This needs to be allocated before the function
+    ///   is called.
+    ///  \param par The Param set, needed for the atrous reconstruction.
+
+    int minscale = par.getMinScale();
+    par.setMinScale(par.filter().getNumScales(size));
+    float atrouscut = par.getAtrousCut();
+    par.setAtrousCut(1);
+    bool flagVerb = par.isVerbose();
+    par.setVerbosity(false);
+
+    float *spec = new float[size];
+    float *trimmed = new float[size*numSpec];
+    float *batchBaseline = new float[size*numSpec];
+    float med,sig;
+    for(size_t b=0;b<numSpec;b++){
+      for(size_t i=0;i<size;i++) spec[i] = input[i*stride+b];
+      findMedianStats(spec,size,med,sig);
+      float threshold = 5. * sig;
+      for(size_t i=0;i<size;i++) {
+	if(fabs(spec[i]-med)>threshold){
+	  if(spec[i]>med) trimmed[i*numSpec+b] = med + threshold;
+	  else trimmed[i*numSpec+b] = med - threshold;
+	}
+	else trimmed[i*numSpec+b] = spec[i];
+      }
+    }
+
+    atrous1DReconstructBatch(size, numSpec, numSpec, trimmed, batchBaseline, par);
+
+    for(size_t i=0;i<size;i++)
+      for(size_t b=0;b<numSpec;b++)
+	baseline[i*stride+b] = batchBaseline[i*numSpec+b];
+
+    par.setMinScale(minscale);
+    par.setAtrousCut(atrouscut);
+    par.setVerbosity(flagVerb);
+
+    delete [] spec;
+    delete [] trimmed;
+    delete [] batchBaseline;
+
+  }
+
 }
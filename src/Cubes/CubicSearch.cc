@@ -29,9 +29,13 @@
 #include <iomanip>
 #include <fstream>
 #include <vector>
+#include <algorithm>
 #include <duchamp/param.hh>
 #include <duchamp/PixelMap/Object3D.hh>
 #include <duchamp/Cubes/cubes.hh>
+#include <duchamp/Detection/finders.hh>
+#include <duchamp/Detection/RunLabeller.hh>
+#include <duchamp/Detection/DetectionGrid.hh>
 #include <duchamp/Utils/utils.hh>
 #include <duchamp/Utils/feedback.hh>
 #include <duchamp/Utils/Statistics.hh>
@@ -85,6 +89,8 @@ std::vector <Detection> search3DArray(size_t *dim, float *Array, Param &par,
     return search3DArraySpectral(dim,Array,par,stats);
   else if(par.getSearchType()=="spatial")
     return search3DArraySpatial(dim,Array,par,stats);
+  else if(par.getSearchType()=="3D")
+    return search3DArrayConnected(dim,Array,par,stats);
   else{
     DUCHAMPERROR("search3DArray","Unknown search type : " << par.getSearchType());
     return std::vector<Detection>(0);
@@ -102,6 +108,8 @@ std::vector <Detection> search3DArraySpectral(size_t *dim, float *Array, Param &
   ///  Returns a vector list of Detections.
   ///  No reconstruction is assumed to have taken place, so statistics are
   ///  calculated (using robust methods) from the data array itself.
+  ///  The spectra are searched in blocks of rows, in parallel, using
+  ///  Param::numThreads threads.
   /// \param dim Array of dimension sizes for the data array.
   /// \param Array Array of data.
   /// \param par Param set defining how to do detection, and what a
@@ -110,6 +118,8 @@ std::vector <Detection> search3DArraySpectral(size_t *dim, float *Array, Param &
   /// \return Vector of detected objects.
 
   std::vector <Detection> outputList;
+  DetectionGrid grid;
+  if(par.getFlagTwoStageMerging()) grid.define(dim,par);
   size_t zdim = dim[2];
   size_t xySize = dim[0] * dim[1];
   int num = 0;
@@ -119,52 +129,104 @@ std::vector <Detection> search3DArraySpectral(size_t *dim, float *Array, Param &
     ProgressBar bar;
     if(par.isVerbose()) bar.init(xySize);
 
-    std::vector<bool> doPixel(xySize,false);
-    for(size_t npix=0; npix<xySize; npix++){
-      for(size_t z=0;z<zdim;z++){
-	doPixel[npix] = doPixel[npix] || 
-	    (!par.isBlank(Array[npix+xySize*z]) && !par.isFlaggedChannel(z));
-      }
-      // doPixel[i] is false only when there are no good pixels in spectrum
-      //  of pixel #i.
-    }
-
-    size_t *specdim = new size_t[2];
-    specdim[0] = zdim; specdim[1]=1;
-    Image *spectrum = new Image(specdim);
-    delete [] specdim;
-    spectrum->saveParam(par);
-    spectrum->saveStats(stats);
-    //    spectrum->setMinSize(par.getMinChannels());
-    spectrum->setMinSize(1);
-
-    for(size_t y=0; y<dim[1]; y++){
-      for(size_t x=0; x<dim[0]; x++){
-
-	size_t npix = y*dim[0] + x;
-	if( par.isVerbose() ) bar.update(npix+1);
-	
-	if(doPixel[npix]){
-	  spectrum->extractSpectrum(Array,dim,npix);
-	  spectrum->removeFlaggedChannels();
-	  std::vector<Scan> objlist = spectrum->findSources1D();
-	  std::vector<Scan>::iterator obj;
-	  num += objlist.size();
-	  for(obj=objlist.begin();obj<objlist.end();obj++){
-	    Detection newObject;
-	    // Fix up coordinates of each pixel to match original array
- 	    for(int z=obj->getX();z<=obj->getXmax();z++) {
-	      newObject.addPixel(x,y,z);
+    // Channels flagged by the user are ignored when deciding whether
+    // a spectrum has any good pixels, and are set to zero (unless
+    // BLANK) before the spectrum is searched, as done by
+    // Image::removeFlaggedChannels().
+    std::vector<bool> flaggedChannel(zdim,false), zeroedChannel(zdim,false);
+    for(size_t z=0;z<zdim;z++) flaggedChannel[z] = par.isFlaggedChannel(z);
+    std::vector<int> flaggedChans = par.getFlaggedChannels();
+    for(size_t i=0;i<flaggedChans.size();i++)
+      if(flaggedChans[i]>=0 && size_t(flaggedChans[i])<zdim) zeroedChannel[flaggedChans[i]] = true;
+    float zero=0.;
+    bool zeroIsDetection = !par.isBlank(zero) && stats.isDetection(zero);
+
+    // The spectra are searched a block of rows at a time, each block
+    // being given to one thread. Rather than extracting each spectrum
+    // from the cube in turn, which reads one value from each channel
+    // map, the block is read a channel at a time, so that each read
+    // is of a contiguous run of pixels. The values are thresholded as
+    // they are read, and only the (much smaller) thresholded spectra
+    // are kept, from which the runs of detected channels are found.
+    // The runs found in each block are kept separately, and turned
+    // into Detections and merged into the output list in order of
+    // block once all blocks have been searched, so the list is the
+    // same whatever the number of threads. A block is aimed at a few
+    // thousand pixels, fewer for long spectra to keep the thresholded
+    // block to about a megabyte.
+    size_t blockPix = std::min(size_t(4096), std::max(size_t(1), size_t(1048576)/zdim));
+    size_t blockRows = std::min(dim[1], std::max(size_t(1), blockPix/dim[0]));
+    size_t numBlocks = (dim[1]+blockRows-1)/blockRows;
+    std::vector< std::vector<Scan> > blockObjects(numBlocks);
+    size_t numDone=0;
+
+#pragma omp parallel num_threads(par.getNumThreads())
+    {
+      std::vector<char> thresholded;
+      std::vector<bool> goodPixel, spectrum(zdim);
+
+#pragma omp for schedule(dynamic)
+      for(long block=0; block<long(numBlocks); block++){
+
+	size_t yStart = block*blockRows;
+	size_t numRows = std::min(blockRows, dim[1]-yStart);
+	size_t first = yStart*dim[0];
+	size_t numPix = numRows*dim[0];
+
+	thresholded.assign(numPix*zdim,0);
+	goodPixel.assign(numPix,false);
+	for(size_t z=0;z<zdim;z++){
+	  float *plane = Array + z*xySize + first;
+	  for(size_t pix=0;pix<numPix;pix++){
+	    if(par.isBlank(plane[pix])) continue;
+	    if(!flaggedChannel[z]) goodPixel[pix] = true;
+	    thresholded[pix*zdim+z] = zeroedChannel[z] ? zeroIsDetection : stats.isDetection(plane[pix]);
+	  }
+	}
+	// goodPixel[i] is false only when there are no good pixels in
+	// the spectrum of pixel #i of the block.
+
+	for(size_t pix=0;pix<numPix;pix++){
+	  if(goodPixel[pix]){
+	    for(size_t z=0;z<zdim;z++) spectrum[z] = thresholded[pix*zdim+z];
+	    std::vector<Scan> objlist = spectrumDetect(spectrum,zdim,1);
+	    std::vector<Scan>::iterator obj;
+	    for(obj=objlist.begin();obj<objlist.end();obj++){
+	      // Keep the spatial pixel in the Scan's y-value
+	      obj->setY(first+pix);
+	      blockObjects[block].push_back(*obj);
 	    }
-	    newObject.setOffsets(par);
-	    if(par.getFlagTwoStageMerging()) mergeIntoList(newObject,outputList,par);
-	    else outputList.push_back(newObject);
 	  }
 	}
+
+	if( par.isVerbose() ){
+#pragma omp critical (searchProgress)
+	  {
+	    numDone += numPix;
+	    bar.update(numDone);
+	  }
+	}
+
       }
     }
 
-    delete spectrum;  
+    for(size_t block=0; block<numBlocks; block++){
+      num += blockObjects[block].size();
+      std::vector<Scan>::iterator obj;
+      for(obj=blockObjects[block].begin();obj<blockObjects[block].end();obj++){
+	Detection newObject;
+	// Fix up coordinates of each pixel to match original array
+	size_t x = obj->getY() % dim[0];
+	size_t y = obj->getY() / dim[0];
+	for(int z=obj->getX();z<=obj->getXmax();z++) {
+	  newObject.addPixel(x,y,z);
+	}
+	newObject.setOffsets(par);
+	if(par.getFlagTwoStageMerging()) mergeIntoList(newObject,outputList,par,grid);
+	else outputList.push_back(newObject);
+      }
+      std::vector<Scan>().swap(blockObjects[block]);
+    }
 
     if(par.isVerbose()){
       bar.remove();
@@ -188,6 +250,8 @@ std::vector <Detection> search3DArraySpatial(size_t *dim, float *Array,
   ///  Returns a vector list of Detections.
   ///  No reconstruction is assumed to have taken place, so only the base
   ///  data array is searched.
+  ///  The channel maps are searched in parallel, using
+  ///  Param::numThreads threads.
   /// \param dim Array of dimension sizes for the data array.
   /// \param Array Array of data.
   /// \param par Param set defining how to do detection, and what a
@@ -196,43 +260,68 @@ std::vector <Detection> search3DArraySpatial(size_t *dim, float *Array,
   /// \return A std::vector of detected objects.
 
   std::vector <Detection> outputList;
+  DetectionGrid grid;
+  if(par.getFlagTwoStageMerging()) grid.define(dim,par);
   size_t zdim = dim[2];
   int num = 0;
 
   ProgressBar bar;
   bool useBar = (zdim>1);
   if(useBar && par.isVerbose()) bar.init(zdim);
-  
-  size_t *imdim = new size_t[2];
-  imdim[0] = dim[0]; imdim[1] = dim[1];
-  Image *channelImage = new Image(imdim);
-  delete [] imdim;
-  channelImage->saveParam(par);
-  channelImage->saveStats(stats);
-  channelImage->setMinSize(1);
 
-  for(size_t z=0; z<zdim; z++){
-
-    if( par.isVerbose() && useBar ) bar.update(z+1);
-
-    if(!par.isFlaggedChannel(z)){
+  // The channel maps are searched independently, so are shared out
+  // between the threads, each of which has its own Image to hold
+  // the current map. The objects found in each channel are kept
+  // separately, and are only turned into Detections and merged into
+  // the output list once all channels have been searched. This is
+  // done in order of channel, so the list is the same whatever the
+  // number of threads.
+  std::vector< std::vector<Object2D> > channelObjects(zdim);
+  size_t numDone=0;
+
+  // A single map is instead split up between the threads by
+  // Image::findSources2D().
+#pragma omp parallel num_threads((zdim>1) ? par.getNumThreads() : 1)
+  {
+    size_t *imdim = new size_t[2];
+    imdim[0] = dim[0]; imdim[1] = dim[1];
+    Image *channelImage = new Image(imdim);
+    delete [] imdim;
+    channelImage->saveParam(par);
+    channelImage->saveStats(stats);
+    channelImage->setMinSize(1);
+    if(zdim>1) channelImage->pars().setNumThreads(1);
+
+#pragma omp for schedule(dynamic)
+    for(long z=0; z<long(zdim); z++){
+
+      if(!par.isFlaggedChannel(z)){
+	channelImage->extractImage(Array,dim,z);
+	channelObjects[z] = channelImage->findSources2D();
+      }
 
-      channelImage->extractImage(Array,dim,z);
-      std::vector<Object2D> objlist = channelImage->findSources2D();
-      std::vector<Object2D>::iterator obj;
-      num += objlist.size();
-      for(obj=objlist.begin();obj!=objlist.end();obj++){
-	Detection newObject;
-	newObject.addChannel(z,*obj);
-	newObject.setOffsets(par);
-	if(par.getFlagTwoStageMerging()) mergeIntoList(newObject,outputList,par);
-	else outputList.push_back(newObject);
+      if( par.isVerbose() && useBar ){
+#pragma omp critical (searchProgress)
+	bar.update(++numDone);
       }
+
     }
 
+    delete channelImage;
   }
 
-  delete channelImage;
+  for(size_t z=0; z<zdim; z++){
+    std::vector<Object2D>::iterator obj;
+    num += channelObjects[z].size();
+    for(obj=channelObjects[z].begin();obj!=channelObjects[z].end();obj++){
+      Detection newObject;
+      newObject.addChannel(z,*obj);
+      newObject.setOffsets(par);
+      if(par.getFlagTwoStageMerging()) mergeIntoList(newObject,outputList,par,grid);
+      else outputList.push_back(newObject);
+    }
+    std::vector<Object2D>().swap(channelObjects[z]);
+  }
 
   if(par.isVerbose()){
     if(useBar) bar.remove();
@@ -241,6 +330,56 @@ std::vector <Detection> search3DArraySpatial(size_t *dim, float *Array,
 
   return outputList;
 }
+//---------------------------------------------------------------
+
+std::vector <Detection> search3DArrayConnected(size_t *dim, float *Array, 
+					       Param &par,
+					       StatsContainer<float> &stats)
+{
+  /// @details
+  ///  Takes a dimension array and data array as input (and Parameter
+  ///  set) and finds the objects that are connected in three
+  ///  dimensions, using a RunLabeller. The channel maps are scanned
+  ///  in turn, and each run of detected pixels is joined to any
+  ///  earlier run that it touches or that is close enough to be
+  ///  merged with it (according to threshSpatial, threshVelocity and
+  ///  flagAdjacent). The objects are the same as those given by
+  ///  search3DArraySpatial() followed by mergeList(), so no further
+  ///  merging is needed.
+  ///  Returns a vector list of Detections.
+  /// \param dim Array of dimension sizes for the data array.
+  /// \param Array Array of data.
+  /// \param par Param set defining how to do detection, and what a
+  ///              BLANK pixel is etc.
+  /// \param stats The statistics that define what a detection is.
+  /// \return A std::vector of detected objects.
+
+  size_t zdim = dim[2];
+  size_t xySize = dim[0]*dim[1];
+
+  ProgressBar bar;
+  bool useBar = (zdim>1);
+  if(useBar && par.isVerbose()) bar.init(zdim);
+
+  RunLabeller labeller(dim[0],dim[1],par);
+  for(size_t z=0; z<zdim; z++){
+
+    if( par.isVerbose() && useBar ) bar.update(z+1);
+
+    if(!par.isFlaggedChannel(z))
+      labeller.addChannel(Array+z*xySize,z,stats);
+
+  }
+
+  std::vector <Detection> outputList = labeller.getObjects();
+
+  if(par.isVerbose()){
+    if(useBar) bar.remove();
+    std::cout << "Found " << outputList.size() << ".\n";
+  }
+
+  return outputList;
+}
 
 
 }
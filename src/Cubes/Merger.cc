@@ -31,12 +31,15 @@
 #include <iomanip>
 #include <math.h>
 #include <vector>
+#include <algorithm>
 #include <duchamp/param.hh>
 #include <duchamp/PixelMap/Object3D.hh>
 #include <duchamp/Cubes/cubes.hh>
 #include <duchamp/Cubes/cubeUtils.hh>
 #include <duchamp/Detection/detection.hh>
 #include <duchamp/Detection/ObjectGrower.hh>
+#include <duchamp/Detection/DetectionGrid.hh>
+#include <duchamp/Detection/UnionFind.hh>
 #include <duchamp/Utils/utils.hh>
 #include <duchamp/Utils/feedback.hh>
 
@@ -70,7 +73,10 @@ namespace duchamp
       if(this->par.getFlagRejectBeforeMerge()) 
 	finaliseList(currentList, this->par);
 
-      mergeList(currentList, this->par);
+      // The 3D search finds the objects already merged (see
+      // search3DArrayConnected()), so there is nothing to merge.
+      if(this->par.getSearchType()!="3D")
+	mergeList(currentList, this->par);
 
       // Do growth stuff
       this->growSources(currentList);
@@ -132,81 +138,95 @@ namespace duchamp
     ///   A function that merges any objects in the list of 
     ///    Detections that are within stated threshold distances.
     ///   Determination of whether objects are close is done by
-    ///    the function areClose. 
-
-    if(objList.size() > 0){
-
-      bool isVerb = par.isVerbose();
-      vector <Detection>::iterator iter;
-      
-      std::vector<bool> isValid(objList.size(),true);
-      int numRemoved=0;
-
-      size_t counter=0, compCounter,goodCounter=0;
-
-      while( counter < (objList.size()-1) ){
-	if(isVerb){
-	  std::cout.setf(std::ios::right);
-	  std::cout << "Merging: " << std::setw(6) << goodCounter+1 << "/" ;
-	  std::cout.unsetf(std::ios::right);
-	  std::cout.setf(std::ios::left);
-	  std::cout << std::setw(6) << objList.size()-numRemoved;
-	  printBackSpace(std::cout,22);
-	  std::cout << std::flush;
-	  std::cout.unsetf(std::ios::left);
-	}
-
-	if(isValid[counter]){
-
-	  compCounter = counter + 1;
-
-	  do {
-
-	    if(isValid[compCounter]){
-
-	      bool close = objList[counter].canMerge(objList[compCounter], par);
-
-	      if(close){
-		objList[counter].addDetection(objList[compCounter]);
-		isValid[compCounter]=false;
-		numRemoved++;
-
-		if(isVerb){
-		  std::cout.setf(std::ios::right);
-		  std::cout << "Merging: "
-			    << std::setw(6) << goodCounter+1 << "/";
-		  std::cout.unsetf(std::ios::right);
-		  std::cout.setf(std::ios::left);
-		  std::cout << std::setw(6) << objList.size()-numRemoved;
-		  printBackSpace(std::cout,22);
-		  std::cout << std::flush;
-		  std::cout.unsetf(std::ios::left);
-		}
-		
-		compCounter = counter + 1;
-		
-	      }
-	      else compCounter++;
-	    }
-	    else compCounter++;
-
-	  } while( (compCounter<objList.size()) );
+    ///    the function Detection::canMerge(). 
+    ///
+    ///   Two objects end up in the same merged object if there is a
+    ///    chain of objects joining them, each of which can be merged
+    ///    with the next. These chains are found with a union-find
+    ///    structure: each pair of objects that a DetectionGrid finds
+    ///    near each other is tested with canMerge(), unless they are
+    ///    already known to be joined, and joined if it succeeds. Each
+    ///    merged object is then made by adding the others to the
+    ///    first of them, in order, and takes its place in the list.
+    ///
+    ///   The tests are shared between Param::numThreads threads, a
+    ///    block of objects at a time. Within a block the union-find
+    ///    structure is only read, and the joins are made at the end
+    ///    of the block. The merged objects do not depend on the
+    ///    number of threads.
+
+    size_t size = objList.size();
+    if(size == 0) return;
+
+    bool isVerb = par.isVerbose();
+    int numThreads = par.getNumThreads();
+
+    DetectionGrid grid(objList,par);
+    UnionFind merged(size);
+
+    size_t blockSize = 256*size_t(numThreads);
+    std::vector< std::vector<size_t> > matches(std::min(blockSize,size));
+    for(size_t start=0; start<size; start+=blockSize){
+      size_t end = std::min(start+blockSize,size);
+
+      if(isVerb){
+	std::cout.setf(std::ios::right);
+	std::cout << "Merging: " << std::setw(6) << start+1 << "/" ;
+	std::cout.unsetf(std::ios::right);
+	std::cout.setf(std::ios::left);
+	std::cout << std::setw(6) << size;
+	printBackSpace(std::cout,22);
+	std::cout << std::flush;
+	std::cout.unsetf(std::ios::left);
+      }
 
+#pragma omp parallel num_threads(numThreads)
+      {
+	std::vector<size_t> candidates;
+#pragma omp for schedule(dynamic)
+	for(long i=long(start); i<long(end); i++){
+	  std::vector<size_t> &match = matches[i-start];
+	  match.clear();
+	  grid.findCandidates(objList[i], candidates);
+	  size_t root = merged.getRoot(i);
+	  std::vector<size_t>::iterator comp = std::upper_bound(candidates.begin(),candidates.end(),size_t(i));
+	  for(; comp!=candidates.end(); comp++){
+	    if(merged.getRoot(*comp)!=root && objList[i].canMerge(objList[*comp], par))
+	      match.push_back(*comp);
+	  }
 	}
-	counter++;
-	if(isValid[counter]) goodCounter++;
-
-      }  // end of while(counter<(objList.size()-1)) loop
+      }
 
-      std::vector<Detection> newlist(objList.size()-numRemoved);
-      size_t ct=0;
-      for(size_t i=0;i<objList.size();i++){
-	if(isValid[i]) newlist[ct++]=objList[i];
+      for(size_t i=start;i<end;i++){
+	for(size_t m=0;m<matches[i-start].size();m++) merged.join(i,matches[i-start][m]);
+	std::vector<size_t>().swap(matches[i-start]);
       }
-      objList.clear();
-      objList=newlist;
+    }
+
+    // List the members of each merged object in order, and add them
+    // to the first. Different merged objects use different parts of
+    // the list, so can be made in parallel.
+    std::vector<size_t> first(size+1,0), member(size), rootOf(size);
+    for(size_t i=0;i<size;i++){
+      rootOf[i] = merged.findRoot(i);
+      first[rootOf[i]+1]++;
+    }
+    for(size_t i=0;i<size;i++) first[i+1] += first[i];
+    std::vector<size_t> next(first.begin(),first.end()-1);
+    for(size_t i=0;i<size;i++) member[next[rootOf[i]]++] = i;
+
+#pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+    for(long root=0; root<long(size); root++){
+      for(size_t m=first[root]+1; m<first[root+1]; m++)
+	objList[root].addDetection(objList[member[m]]);
+    }
 
+    std::vector<Detection> newlist;
+    for(size_t i=0;i<size;i++){
+      if(rootOf[i]==i) newlist.push_back(objList[i]);
     }
+    objList.swap(newlist);
+
   }
 
 
@@ -27,6 +27,7 @@
 // -----------------------------------------------------------------------
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include <duchamp/param.hh>
 #include <duchamp/ATrous/atrous.hh>
 #include <duchamp/Cubes/cubes.hh>
@@ -39,7 +40,10 @@ namespace duchamp
   {
     /// @details
     ///  A front-end to the findAtrousBaseline routine, specialised for the 
-    ///  Cube data structure. Calls findAtrousBaseline on each spectrum individually.
+    ///  Cube data structure. Calls findAtrousBaseline on each spectrum.
+    ///  For the atrous baseline, the spectra of adjacent pixels are
+    ///   done in batches of atrousBatchSize, so that the cube is read
+    ///   in contiguous runs, rather than one value per channel.
     ///  Upon exit, the original array minus its spectral baseline is stored
     ///   in this->array and the baseline is in this->baseline.
     ///  If the reconstructed array exists, the baseline is subtracted from 
@@ -48,27 +52,33 @@ namespace duchamp
     float *spec     = new float[this->axisDim[2]];
     float *thisBaseline = new float[this->axisDim[2]];
     size_t numSpec = this->axisDim[0]*this->axisDim[1];
+    bool useBatches = (this->par.getBaselineType()=="atrous");
+    size_t batchSize = useBatches ? atrousBatchSize : 1;
 
     ProgressBar bar;
     if(this->par.isVerbose()) bar.init(numSpec);
-    for(size_t pix=0; pix<numSpec; pix++){ // for each spatial pixel...
-
-      if(this->par.isVerbose() ) bar.update(pix+1);
-
-      for(size_t z=0; z<this->axisDim[2]; z++)  
-	spec[z] = this->array[z*numSpec + pix];
-
-      if(this->par.getBaselineType()=="atrous")
-	  findAtrousBaseline(this->axisDim[2], spec, thisBaseline, this->par);
-      else
-	  findMedianBaseline(this->axisDim[2], spec, this->par.getBaselineBoxWidth(), thisBaseline);
+    for(size_t pix=0; pix<numSpec; pix+=batchSize){ // for each spatial pixel...
+
+      size_t num = std::min(batchSize, numSpec-pix);
+      if(this->par.isVerbose() ) bar.update(pix+num);
+
+      if(useBatches)
+	findAtrousBaseline(this->axisDim[2], num, numSpec, this->array+pix, this->baseline+pix, this->par);
+      else{
+	for(size_t z=0; z<this->axisDim[2]; z++)  
+	  spec[z] = this->array[z*numSpec + pix];
+	findMedianBaseline(this->axisDim[2], spec, this->par.getBaselineBoxWidth(), thisBaseline);
+	for(size_t z=0; z<this->axisDim[2]; z++)
+	  this->baseline[z*numSpec+pix] = thisBaseline[z];
+      }
 
       for(size_t z=0; z<this->axisDim[2]; z++) {
-	this->baseline[z*numSpec+pix] = thisBaseline[z];
-	if(!par.isBlank(this->array[z*numSpec+pix])){
-	  this->array[z*numSpec+pix] -= thisBaseline[z];
-	  if(this->reconExists) this->recon[z*numSpec+pix] -= thisBaseline[z];
-	}      
+	for(size_t i=z*numSpec+pix; i<z*numSpec+pix+num; i++){
+	  if(!par.isBlank(this->array[i])){
+	    this->array[i] -= this->baseline[i];
+	    if(this->reconExists) this->recon[i] -= this->baseline[i];
+	  }      
+	}
       }
 
     }  
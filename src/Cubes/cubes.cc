@@ -674,7 +674,7 @@ namespace duchamp
     }
       
     if(this->par.getFlagSmooth()){
-	if(this->par.getSmoothType()=="spectral" && this->numNondegDim==2){
+	if((this->par.getSmoothType()=="spectral" || this->par.getSmoothType()=="recursive") && this->numNondegDim==2){
 	    DUCHAMPWARN("Cube::initialiseCube", "Spectral smooth requested, but have a 2D image. Setting flagSmooth=false");
 	    this->par.setFlagSmooth(false);
 	}
@@ -682,6 +682,10 @@ namespace duchamp
 	    DUCHAMPWARN("Cube::initialiseCube", "Spatial smooth requested, but have a 1D image. Setting flagSmooth=false");
 	    this->par.setFlagSmooth(false);
 	}
+	if(this->par.getSmoothType()=="3D" && this->numNondegDim<3){
+	    DUCHAMPWARN("Cube::initialiseCube", "3D smooth requested, but have a " << this->numNondegDim << "D image. Setting flagSmooth=false");
+	    this->par.setFlagSmooth(false);
+	}
     }
     if(this->par.getFlagATrous()){
 	for(int d=3; d>=1; d--){
@@ -692,7 +696,25 @@ namespace duchamp
 	}
     }
 
-    if(allocateArrays && this->par.isVerbose()) this->reportMemorySize(std::cout,allocateArrays);
+    // The smoothed search keeps the input cube, the smoothed cube
+    // and (if the statistics are needed) a copy of the good pixels
+    // from which to find them. If that is more than the smoothMemory
+    // budget, the cube is instead smoothed and searched a window at a
+    // time (see Cube::StreamSmoothSearch()), and the recon array is
+    // not allocated.
+    bool allocateRecon = this->par.getFlagATrous() || this->par.getFlagSmooth();
+    if(this->par.getFlagSmooth() && !this->par.getFlagATrous() && this->par.getSmoothMemory()>0.){
+	double needed = double(size) * sizeof(float) * (this->par.getFlagUserThreshold() ? 2. : 3.);
+	if(needed > this->par.getSmoothMemory()*1024.*1024.){
+	    std::string reason;
+	    if(this->canStreamSmoothing(reason)) allocateRecon = false;
+	    else{
+		DUCHAMPWARN("Cube::initialiseCube", "The smoothed search needs about " << needed/1024./1024. << "MB, which is more than the smoothMemory value of " << this->par.getSmoothMemory() << "MB, but it cannot be done a window at a time as " << reason << ". Keeping the whole smoothed cube.");
+	    }
+	}
+    }
+
+    if(allocateArrays && this->par.isVerbose()) this->reportMemorySize(std::cout,allocateArrays,allocateRecon);
 
     this->reconExists = false;
     if(allocateArrays){
@@ -700,7 +722,7 @@ namespace duchamp
 	this->arrayAllocated = true;
 	this->detectMap  = new short[imsize];
 	for(size_t i=0;i<imsize;i++) this->detectMap[i] = 0;
-	if(this->par.getFlagATrous() || this->par.getFlagSmooth()){
+	if(allocateRecon){
 	    this->recon    = new float[size];
 	    this->reconAllocated = true;
 	    for(size_t i=0;i<size;i++) this->recon[i] = 0.;
@@ -716,7 +738,7 @@ namespace duchamp
   }
   //--------------------------------------------------------------------
 
-  void Cube::reportMemorySize(std::ostream &theStream, bool allocateArrays)
+  void Cube::reportMemorySize(std::ostream &theStream, bool allocateArrays, bool allocateRecon)
   {
     std::string unitlist[4]={"kB","MB","GB","TB"};
     size_t size=axisDim[0]*axisDim[1]*axisDim[2];
@@ -729,7 +751,7 @@ namespace duchamp
 	allocSize += size * sizeof(float); // array
 	arrAllocSize = size*sizeof(float);
 	allocSize += imsize * sizeof(short); // detectMap
-	if(this->par.getFlagATrous() || this->par.getFlagSmooth()) 
+	if(allocateRecon && (this->par.getFlagATrous() || this->par.getFlagSmooth()))
 	  allocSize += size * sizeof(float); // recon
 	if(this->par.getFlagBaseline())
 	  allocSize += size * sizeof(float); // baseline
@@ -889,7 +911,9 @@ namespace duchamp
     ///      <li>Wavelet reconstruction: mean & median calculated from the 
     ///          original array, and stddev & madfm from the residual.
     ///      <li>Smoothing: all four stats calculated from the recon array 
-    ///          (which holds the smoothed data).
+    ///          (which holds the smoothed data), or from the smoothed
+    ///          data a window at a time if the recon array has not
+    ///          been allocated (see Cube::calcSmoothedStats()).
     ///  </ul>
 
     if(this->par.getFlagUserThreshold() ){
@@ -993,8 +1017,12 @@ namespace duchamp
 	// get all four stats from the recon array, which holds the
 	// smoothed data. This can just be done with the
 	// StatsContainer::calculate function, using the mask generated
-	// earlier.
-	if(!this->reconExists){
+	// earlier. If the smoothed cube is not being kept, it is
+	// smoothed again a window at a time to find them.
+	if(!this->reconAllocated){
+	  this->calcSmoothedStats(mask);
+	}
+	else if(!this->reconExists){
 	  DUCHAMPERROR("setCubeStats","Smoothing not yet done! Cannot calculate stats!");
 	}
 	else{
@@ -1227,7 +1255,11 @@ namespace duchamp
     }  
     else if(this->par.getFlagSmooth()){
       if(this->par.isVerbose()) std::cout<<"Commencing search in smoothed cube..."<<std::endl;
-      this->SmoothSearch();
+      // If the recon array was not allocated, the smoothed cube is
+      // too big to keep (see initialiseCube()), so it is searched as
+      // it is smoothed.
+      if(this->reconAllocated) this->SmoothSearch();
+      else this->StreamSmoothSearch();
     }
     else{
       if(this->par.isVerbose()) std::cout<<"Commencing search in cube..."<<std::endl;
@@ -1295,13 +1327,17 @@ namespace duchamp
 	if(!this->par.getFlagUserThreshold()){
 	    
 	    float peak=obj->getPeakFlux();
-	    if(this->par.getFlagATrous() || this->par.getFlagSmooth()) {
+	    if(this->reconExists && (this->par.getFlagATrous() || this->par.getFlagSmooth())) {
 		// for these situations, need to measure peak flux in the reconstructed array, where we do the searching
 		Detection *newobj = new Detection(*obj);
 		newobj->calcFluxes(this->recon,this->axisDim);
 		peak=newobj->getPeakFlux();
 		delete newobj;
 	    }
+	    else if(this->par.getFlagSmooth() && obj->hasSearchPeak()){
+		// the smoothed cube was searched a window at a time, and not kept, so use the peak found then
+		peak=obj->getSearchPeak();
+	    }
 	    obj->setPeakSNR( (peak - this->Stats.getMiddle()) / this->Stats.getSpread() );
 
 	    if(!this->par.getFlagSmooth()){
@@ -1364,12 +1400,16 @@ namespace duchamp
 	if(!this->par.getFlagUserThreshold()){
 
 	    float peak=obj->getPeakFlux();
-	    if(this->par.getFlagATrous() || this->par.getFlagSmooth()) {
+	    if(this->reconExists && (this->par.getFlagATrous() || this->par.getFlagSmooth())) {
 		// for these situations, need to measure peak flux in the reconstructed array, where we do the searching
 		Detection *newobj = new Detection(*obj);
 		newobj->calcFluxes(this->recon,this->axisDim);
 		peak=newobj->getPeakFlux();
 	    }
+	    else if(this->par.getFlagSmooth() && obj->hasSearchPeak()){
+		// the smoothed cube was searched a window at a time, and not kept, so use the peak found then
+		peak=obj->getSearchPeak();
+	    }
 	    obj->setPeakSNR( (peak - this->Stats.getMiddle()) / this->Stats.getSpread() );
 
 	    if(!this->par.getFlagSmooth()){
@@ -1431,12 +1471,16 @@ namespace duchamp
 	if(!this->par.getFlagUserThreshold()){
 	    
 	    float peak=obj->getPeakFlux();
-	    if(this->par.getFlagATrous() || this->par.getFlagSmooth()) {
+	    if(this->reconExists && (this->par.getFlagATrous() || this->par.getFlagSmooth())) {
 		// for these situations, need to measure peak flux in the reconstructed array, where we do the searching
 		Detection *newobj = new Detection(*obj);
 		newobj->calcFluxes(this->recon,this->axisDim);
 		peak=newobj->getPeakFlux();
 	    }
+	    else if(this->par.getFlagSmooth() && obj->hasSearchPeak()){
+		// the smoothed cube was searched a window at a time, and not kept, so use the peak found then
+		peak=obj->getSearchPeak();
+	    }
 	    obj->setPeakSNR( (peak - this->Stats.getMiddle()) / this->Stats.getSpread() );
 
 	    if(!this->par.getFlagSmooth()){
@@ -2093,14 +2137,18 @@ namespace duchamp
 
   std::vector<Object2D> Image::findSources2D() 
   {
-    std::vector<bool> thresholdedArray(this->axisDim[0]*this->axisDim[1]);
-    for(size_t posY=0;posY<this->axisDim[1];posY++){
-      for(size_t posX=0;posX<this->axisDim[0];posX++){
-	size_t loc = posX + this->axisDim[0]*posY;
-	thresholdedArray[loc] = this->isDetection(posX,posY);
-      }
-    }
-    return lutz_detect(thresholdedArray, this->axisDim[0], this->axisDim[1], this->minSize);
+    /// @details
+    ///  Finds the runs of detected pixels in each row of the image,
+    ///  using the same test as isDetection(), and joins them into
+    ///  objects with the run-based version of lutz_detect(). A large
+    ///  image is split into strips that are searched in parallel by
+    ///  stripDetect(), using Param::numThreads threads.
+
+    if(this->par.getNumThreads()>1)
+      return stripDetect(this->array, this->axisDim[0], this->axisDim[1], this->minSize, this->par, this->Stats);
+
+    std::vector<Scan> runs = findRuns(this->array, this->axisDim[0], this->axisDim[1], this->par, this->Stats);
+    return lutz_detect(runs, this->minSize);
   }
 
   std::vector<Scan> Image::findSources1D() 
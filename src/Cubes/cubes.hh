@@ -65,6 +65,8 @@ namespace duchamp
 						Statistics::StatsContainer<float> &stats);
   std::vector <Detection> search3DArraySpatial(size_t *dim, float *Array, Param &par,
 					       Statistics::StatsContainer<float> &stats);
+  std::vector <Detection> search3DArrayConnected(size_t *dim, float *Array, Param &par,
+						 Statistics::StatsContainer<float> &stats);
 
 
   //=========================================================================
@@ -226,7 +228,7 @@ namespace duchamp
     short int   nondegDim(){return numNondegDim;};
     bool        is2D();
     void        checkDim(){head.set2D(is2D());};
-    void        reportMemorySize(std::ostream &theStream, bool allocateArrays);
+    void        reportMemorySize(std::ostream &theStream, bool allocateArrays, bool allocateRecon=true);
 
     // INLINE functions -- definitions included after class declaration.
     /// @brief Is the voxel number given by vox a BLANK value? 
@@ -470,12 +472,18 @@ namespace duchamp
     void        SmoothCube();
     /// @brief Front-end to the smoothing and searching functions. 
     void        SmoothSearch();
-    /// @brief A function to spatially smooth the cube and search the result. 
-    void        SpatialSmoothNSearch();
-    /// @brief A function to Hanning-smooth the cube. 
+    /// @brief Smooth the cube and search it a window at a time, without keeping the smoothed cube.
+    void        StreamSmoothSearch();
+    /// @brief Can the smoothed search be done a window at a time?
+    bool        canStreamSmoothing(std::string &reason);
+    /// @brief Find the statistics of the smoothed cube without keeping it.
+    void        calcSmoothedStats(const std::vector<bool> &mask);
+    /// @brief A function to Hanning-smooth (or recursively Gaussian-smooth) the cube. 
     void        SpectralSmooth();
     /// @brief A function to spatially-smooth the cube. 
     void        SpatialSmooth();
+    /// @brief A function to smooth the cube both spectrally and spatially. 
+    void        Smooth3D();
 
     void        Simple3DSearch(){
       /// @brief Basic front-end to the simple 3d searching function -- does
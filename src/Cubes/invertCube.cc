@@ -36,6 +36,9 @@ namespace duchamp
     /// @details A function that multiplies all non-Blank pixels by
     ///  -1.  This is used when searching for negative features. This
     ///  only has an effect when the main array has been allocated.
+    ///  The range of values each object was found with (see
+    ///  Detection::setSearchRange()) is inverted only along with the
+    ///  arrays, as it describes the array searched.
 
     if(doArrays){
       if(this->arrayAllocated){
@@ -50,7 +53,7 @@ namespace duchamp
     if(doObjects){
       std::vector<Detection>::iterator obj;
       for(obj=this->objectList->begin(); obj<this->objectList->end(); obj++) 
-	obj->invert();
+	obj->invert(doArrays);
     }
   }
 
@@ -26,14 +26,21 @@
 //                    AUSTRALIA
 // -----------------------------------------------------------------------
 #include <vector>
+#include <string>
+#include <algorithm>
+#include <math.h>
 #include <duchamp/duchamp.hh>
 #include <duchamp/Cubes/cubes.hh>
 #include <duchamp/Detection/detection.hh>
+#include <duchamp/Detection/DetectionGrid.hh>
+#include <duchamp/Detection/RunLabeller.hh>
 #include <duchamp/PixelMap/Object2D.hh>
 #include <duchamp/Utils/feedback.hh>
 #include <duchamp/Utils/Hanning.hh>
+#include <duchamp/Utils/RecursiveGauss1D.hh>
 #include <duchamp/Utils/GaussSmooth2D.hh>
 #include <duchamp/Utils/Statistics.hh> 
+#include <duchamp/Utils/StreamingMedian.hh>
 #include <duchamp/Utils/utils.hh>
 
 namespace duchamp
@@ -88,7 +95,7 @@ void Cube::SmoothCube()
   ///  which to smooth the cube, based on the Param::smoothType
   ///  parameter.
 
-  if(this->par.getSmoothType()=="spectral"){
+  if(this->par.getSmoothType()=="spectral" || this->par.getSmoothType()=="recursive"){
     
     this->SpectralSmooth();
     
@@ -98,6 +105,11 @@ void Cube::SmoothCube()
     this->SpatialSmooth();
     
   }
+  else if(this->par.getSmoothType()=="3D"){
+    
+    this->Smooth3D();
+    
+  }
 }
 //-----------------------------------------------------------
 
@@ -106,51 +118,40 @@ void Cube::SpectralSmooth()
   /// @details
   ///   A function that smoothes each spectrum in the cube using the 
   ///    Hanning smoothing function. The degree of smoothing is given
-  ///    by the parameter Param::hanningWidth.
+  ///    by the parameter Param::hanningWidth. The cube is smoothed a
+  ///    channel map at a time, with the spatial pixels shared between
+  ///    Param::numThreads threads.
+  ///
+  ///   If Param::smoothType is "recursive", each spectrum is instead
+  ///    smoothed with a Gaussian of FWHM Param::spectralFWHM channels,
+  ///    applied with a recursive filter (see RecursiveGauss1D).
 
   size_t xySize = this->axisDim[0]*this->axisDim[1];
   size_t zdim = this->axisDim[2];
-  ProgressBar bar;
 
-  if(!this->reconExists && this->par.getSmoothType()=="spectral"){
+  std::string smoothType = this->par.getSmoothType();
+  if(!this->reconExists && (smoothType=="spectral" || smoothType=="recursive")){
     //    if(!this->head.isSpecOK())
     if(!this->head.canUseThirdAxis()){
       DUCHAMPWARN("SpectralSmooth","There is no spectral axis, so cannot do the spectral smoothing.");
     }
     else{
 
-      Hanning hann(this->par.getHanningWidth());
-  
-      float *spectrum = new float[this->axisDim[2]];
-
-      if(this->par.isVerbose()) {
-	std::cout<<"  Smoothing spectrally... ";
-	bar.init(xySize);
-      }
+      std::vector<bool> mask = this->par.makeBlankMask(this->array, xySize*zdim);
 
-      for(size_t pix=0;pix<xySize;pix++){
+      if(this->par.isVerbose()) std::cout<<"  Smoothing spectrally... " << std::flush;
 
-	if( this->par.isVerbose() ) bar.update(pix+1);
-    
-	for(size_t z=0;z<zdim;z++){
-	  if(this->isBlank(z*xySize+pix)) spectrum[z]=0.;
-	  else spectrum[z] = this->array[z*xySize+pix];
-	}
-
-	float *smoothed = hann.smooth(spectrum,zdim);
-
-	for(size_t z=0;z<zdim;z++){
-	  if(this->isBlank(z*xySize+pix)) 
-	    this->recon[z*xySize+pix] = this->array[z*xySize+pix];
-	  else 
-	    this->recon[z*xySize+pix] = smoothed[z];
-	}
-	delete [] smoothed;
+      if(smoothType=="recursive"){
+	RecursiveGauss1D gauss(this->par.getSpectralFWHM());
+	gauss.smoothSpectra(this->array, this->recon, xySize, zdim, mask, this->par.getNumThreads());
+      }
+      else{
+	Hanning hann(this->par.getHanningWidth());
+	hann.smoothSpectra(this->array, this->recon, xySize, zdim, mask, this->par.getNumThreads());
       }
-      this->reconExists = true;
-      if(this->par.isVerbose()) bar.fillSpace("All Done.\n");
 
-      delete [] spectrum;
+      this->reconExists = true;
+      if(this->par.isVerbose()) std::cout << "All Done.\n";
 
     }
   }
@@ -190,31 +191,132 @@ void Cube::SpatialSmooth()
 	if(useBar) bar.init(zdim);
       }
 
-      // pointer used to point to start of a given channel's image
-      //  Can do this because the spatial axes vary the quickest.
-      float *image=0;
-
       EDGES edgeTreatment=EQUALTOEDGE;
       if(this->par.getSmoothEdgeMethod()=="equal") edgeTreatment=EQUALTOEDGE;
       else if(this->par.getSmoothEdgeMethod()=="truncate") edgeTreatment=TRUNCATE;
       else if(this->par.getSmoothEdgeMethod()=="scale") edgeTreatment=SCALEBYCOVERAGE;
 
+      // The channel maps are smoothed independently, so are shared
+      // out between the threads. The BLANK mask of the whole cube is
+      // found once and shared, and each channel is smoothed straight
+      // into its place in the recon array. The threads also share the
+      // kernel, and its Fourier transform if that is used, which is
+      // found once beforehand.
+      std::vector<bool> mask = this->par.makeBlankMask(this->array,xySize*zdim);
+      gauss.prepare(xdim,ydim);
+      size_t numDone=0;
+
+#pragma omp parallel for schedule(dynamic) num_threads(this->par.getNumThreads())
+      for(long z=0;z<long(zdim);z++){
+
+	gauss.smooth(this->array+z*xySize,xdim,ydim,mask,z*xySize,
+		     this->recon+z*xySize,edgeTreatment);
+
+	if(useBar){
+#pragma omp critical (smoothProgress)
+	  bar.update(++numDone);
+	}
+      }
 
-      for(size_t z=0;z<zdim;z++){
+      this->reconExists = true;
+  
+      if(par.isVerbose()){
+	if(useBar) bar.fillSpace("All Done.");
+	std::cout << "\n";
+      }
 
-	if(useBar) bar.update(z+1);
-      
-	// update pointer to point to current channel
-	image = this->array + z*xySize;
-    
-	std::vector<bool> mask = this->par.makeBlankMask(image,xySize);
-    
-	float *smoothed = gauss.smooth(image,xdim,ydim,mask,edgeTreatment);
-    
-	for(size_t pix=0;pix<xySize;pix++) 
-	    this->recon[z*xySize+pix] = smoothed[pix];
+    }
+  }
+}
+//-----------------------------------------------------------
 
-	if(gauss.isAllocated()) delete [] smoothed;
+void Cube::Smooth3D()
+{
+  /// @details
+  ///   A function that smoothes the cube both spectrally, with the
+  ///    Hanning filter of width Param::hanningWidth, and spatially,
+  ///    with the 2D Gaussian kernel defined by Param::kernMaj,
+  ///    Param::kernMin and Param::kernPA (treating the edges according
+  ///    to Param::smoothEdgeMethod).
+  ///
+  ///   The cube is worked through a block of channels at a time. The
+  ///    channels of a block are first smoothed spectrally (see
+  ///    Hanning::smoothSpectra()) into a buffer that holds only that
+  ///    block, and each of these channel maps is then smoothed
+  ///    spatially straight into its place in the recon array. So
+  ///    there is no intermediate cube, and the block stays in cache
+  ///    between the two stages. Both stages share the work between
+  ///    Param::numThreads threads.
+  ///
+  ///   The BLANK pixels are treated as for the spectral and spatial
+  ///    smoothing: they do not contribute to either stage, and are
+  ///    left unchanged in the recon array.
+
+  if(!this->reconExists && this->par.getSmoothType()=="3D"){
+
+    if( this->head.getNumAxes() < 3 || !this->head.canUseThirdAxis() ){
+      DUCHAMPWARN("Smooth3D","There are not enough axes to do the 3D smoothing.");
+    }
+    else{
+
+      size_t xySize = this->axisDim[0]*this->axisDim[1];
+      size_t xdim = this->axisDim[0];
+      size_t ydim = this->axisDim[1];
+      size_t zdim = this->axisDim[2];
+
+      ProgressBar bar;
+      bool useBar = this->par.isVerbose() && (zdim > 1);
+
+      // if kernMin is negative (not defined), make it equal to kernMaj
+      if(this->par.getKernMin() < 0) 
+	this->par.setKernMin(this->par.getKernMaj());
+
+      std::cout << "  ";
+      GaussSmooth2D<float> gauss(this->par.getKernMaj(),
+				 this->par.getKernMin(),
+				 this->par.getKernPA(),
+				 this->par.getSpatialSmoothCutoff());
+      Hanning hann(this->par.getHanningWidth());
+
+      if(this->par.isVerbose()) {
+	std::cout<<"  Smoothing in 3D... " << std::flush;
+	if(useBar) bar.init(zdim);
+      }
+
+      EDGES edgeTreatment=EQUALTOEDGE;
+      if(this->par.getSmoothEdgeMethod()=="equal") edgeTreatment=EQUALTOEDGE;
+      else if(this->par.getSmoothEdgeMethod()=="truncate") edgeTreatment=TRUNCATE;
+      else if(this->par.getSmoothEdgeMethod()=="scale") edgeTreatment=SCALEBYCOVERAGE;
+
+      std::vector<bool> mask = this->par.makeBlankMask(this->array,xySize*zdim);
+
+      // Enough channels in a block to keep all the threads busy in
+      // the spatial stage, without the buffer getting too big. The
+      // threads share the spatial kernel (and its Fourier transform,
+      // found once for the whole cube), and each takes every
+      // numThreads-th channel of each block.
+      int numThreads = std::max(this->par.getNumThreads(),1);
+      size_t blockSize = std::min(zdim, size_t(std::max(2*numThreads,8)));
+      std::vector<float> block(blockSize*xySize);
+      gauss.prepare(xdim,ydim);
+      size_t numDone=0;
+
+      for(size_t z0=0;z0<zdim;z0+=blockSize){
+	size_t numChannels = std::min(blockSize, zdim-z0);
+
+	hann.smoothSpectra(this->array, &block[0], xySize, zdim, z0, numChannels, mask, numThreads);
+
+#pragma omp parallel for schedule(static) num_threads(numThreads)
+	for(long t=0;t<long(numThreads);t++){
+	  for(size_t i=t;i<numChannels;i+=numThreads){
+	    size_t z = z0+i;
+	    gauss.smooth(&block[i*xySize],xdim,ydim,mask,z*xySize,
+			 this->recon+z*xySize,edgeTreatment);
+	  }
+	}
+
+	numDone += numChannels;
+	if(useBar) bar.update(numDone);
       }
 
       this->reconExists = true;
@@ -229,81 +331,522 @@ void Cube::SpatialSmooth()
 }
 //-----------------------------------------------------------
 
-void Cube::SpatialSmoothNSearch()
+/// @brief
+///  Smooth a cube a window at a time.
+/// @details
+///  This is used to search a smoothed cube without keeping the whole
+///  of the smoothed cube (see Cube::StreamSmoothSearch()). The cube is
+///  split into windows that each cover whole rows: a block of
+///  channel maps when the channel maps are to be searched
+///  (Param::searchType="spatial" or "3D"), or a slab of rows through
+///  all the channels when the spectra are to be searched. Each call to next()
+///  smooths the next window with the method given by
+///  Param::smoothType. The values are the same as those in the
+///  corresponding part of the cube smoothed by Cube::SmoothCube().
+///
+///  A window is held with the same ordering as the cube, and its
+///  dimensions (given by windowDim()) are those of a cube of that
+///  size, so it can be searched in the same way as the full cube.
+
+class SmoothingSweep
+{
+public:
+  SmoothingSweep(float *array, size_t *dim, Param &par);
+  virtual ~SmoothingSweep(){};
+
+  /// @brief Go back to the first window.
+  void    start(){nextStart=0;};
+  /// @brief Smooth the next window. Returns false when there are no more.
+  bool    next();
+  /// @brief The smoothed values of the current window.
+  float  *window(){return &smoothed[0];};
+  /// @brief The dimensions of the current window.
+  size_t *windowDim(){return windowDimensions;};
+  /// @brief The channel of the cube at the start of the current window.
+  size_t  firstChannel(){return zFirst;};
+  /// @brief The row of the cube at the start of the current window.
+  size_t  firstRow(){return yFirst;};
+  /// @brief The number of windows in the cube.
+  size_t  numWindows(){return ((byChannel ? zdim : ydim) + windowLength - 1) / windowLength;};
+  /// @brief The number of bytes used for the windows and masks.
+  size_t  memoryUsage();
+
+private:
+  float  *array;            ///< The cube being smoothed.
+  Param  &par;              ///< The parameters, defining the smoothing.
+  size_t  xdim,ydim,zdim,xySize;
+  bool    byChannel;        ///< Is the cube split into blocks of channels, rather than slabs of rows?
+  size_t  windowLength;     ///< The number of channels (or rows) in a window.
+  size_t  nextStart;        ///< The first channel (or row) of the next window.
+  size_t  zFirst,yFirst;
+  size_t  windowDimensions[3];
+  int     numThreads;
+  std::string smoothType;
+  Hanning hann;
+  RecursiveGauss1D recursiveGauss;
+  GaussSmooth2D<float> gauss; ///< The spatial kernel, shared by the threads.
+  EDGES   edgeTreatment;
+  std::vector<bool>  mask;      ///< BLANK mask of the whole cube (for blocks of channels) or of the window (for slabs).
+  std::vector<float> smoothed;  ///< The smoothed window.
+  std::vector<float> work;      ///< The input slab, or the spectrally smoothed block for 3D smoothing.
+};
+
+SmoothingSweep::SmoothingSweep(float *array, size_t *dim, Param &par):
+  array(array), par(par)
+{
+  /// @details
+  ///  Sets up the kernels and the window buffers. The windows are as
+  ///  big as the blocks used by Cube::Smooth3D(), so that there is
+  ///  enough work in each to share between the threads: a slab of
+  ///  rows holds about as many pixels as a block of channel maps.
+  /// \param array The cube to be smoothed.
+  /// \param dim The dimensions of the cube.
+  /// \param par The parameters, giving the smoothing method and the search type.
+
+  this->xdim = dim[0];
+  this->ydim = dim[1];
+  this->zdim = dim[2];
+  this->xySize = this->xdim*this->ydim;
+  this->smoothType = par.getSmoothType();
+  this->byChannel = (par.getSearchType()!="spectral");
+  this->numThreads = std::max(par.getNumThreads(),1);
+
+  size_t numChannels = std::min(this->zdim, size_t(std::max(2*this->numThreads,8)));
+  size_t windowSize;
+  if(this->byChannel){
+    this->windowLength = numChannels;
+    windowSize = numChannels*this->xySize;
+    this->mask = par.makeBlankMask(array, this->xySize*this->zdim);
+  }
+  else{
+    this->windowLength = std::min(this->ydim, std::max(size_t(1), (numChannels*this->ydim)/this->zdim));
+    windowSize = this->windowLength*this->xdim*this->zdim;
+    this->mask = std::vector<bool>(windowSize);
+    this->work = std::vector<float>(windowSize);
+  }
+  this->smoothed = std::vector<float>(windowSize);
+
+  if(this->smoothType=="spectral" || this->smoothType=="3D")
+    this->hann.define(par.getHanningWidth());
+  if(this->smoothType=="recursive")
+    this->recursiveGauss.define(par.getSpectralFWHM());
+  if(this->smoothType=="spatial" || this->smoothType=="3D"){
+    if(par.getKernMin() < 0) par.setKernMin(par.getKernMaj());
+    this->gauss.define(par.getKernMaj(), par.getKernMin(), par.getKernPA(), par.getSpatialSmoothCutoff());
+    this->gauss.prepare(this->xdim,this->ydim);
+    this->edgeTreatment=EQUALTOEDGE;
+    if(par.getSmoothEdgeMethod()=="truncate") this->edgeTreatment=TRUNCATE;
+    else if(par.getSmoothEdgeMethod()=="scale") this->edgeTreatment=SCALEBYCOVERAGE;
+    if(this->smoothType=="3D") this->work = std::vector<float>(windowSize);
+  }
+
+  this->nextStart = 0;
+  this->zFirst = this->yFirst = 0;
+  for(int i=0;i<3;i++) this->windowDimensions[i] = 0;
+}
+//-----------------------------------------------------------
+
+size_t SmoothingSweep::memoryUsage()
+{
+  return (this->smoothed.size()+this->work.size())*sizeof(float) + this->mask.size()/8;
+}
+//-----------------------------------------------------------
+
+bool SmoothingSweep::next()
+{
+  /// @details
+  ///  Smooths the next window of the cube, in the same way as
+  ///  Cube::SpectralSmooth(), Cube::SpatialSmooth() or
+  ///  Cube::Smooth3D() would for the whole cube. A block of channels
+  ///  uses the channel-range form of Hanning::smoothSpectra(), so
+  ///  needs no halo. A slab of rows is copied (with its BLANK mask)
+  ///  into a buffer of whole spectra, which are then smoothed.
+  /// \return True if a window was smoothed, false if the end of the
+  /// cube had already been reached.
+
+  size_t length = this->byChannel ? this->zdim : this->ydim;
+  if(this->nextStart >= length) return false;
+  size_t num = std::min(this->windowLength, length-this->nextStart);
+
+  if(this->byChannel){
+    this->zFirst = this->nextStart;
+    this->yFirst = 0;
+    this->windowDimensions[0] = this->xdim;
+    this->windowDimensions[1] = this->ydim;
+    this->windowDimensions[2] = num;
+
+    float *spatialInput = this->array + this->zFirst*this->xySize;
+    if(this->smoothType=="spectral")
+      this->hann.smoothSpectra(this->array, &this->smoothed[0], this->xySize, this->zdim, this->zFirst, num,
+			       this->mask, this->numThreads);
+    else if(this->smoothType=="3D"){
+      this->hann.smoothSpectra(this->array, &this->work[0], this->xySize, this->zdim, this->zFirst, num,
+			       this->mask, this->numThreads);
+      spatialInput = &this->work[0];
+    }
+
+    if(this->smoothType=="spatial" || this->smoothType=="3D"){
+      // As in Cube::Smooth3D(), each thread takes every
+      // numThreads-th channel map of the window.
+#pragma omp parallel for schedule(static) num_threads(this->numThreads)
+      for(long t=0;t<long(this->numThreads);t++){
+	for(size_t i=t;i<num;i+=this->numThreads){
+	  size_t z = this->zFirst+i;
+	  this->gauss.smooth(spatialInput+i*this->xySize, this->xdim, this->ydim, this->mask, z*this->xySize,
+			     &this->smoothed[i*this->xySize], this->edgeTreatment);
+	}
+      }
+    }
+  }
+  else{
+    this->zFirst = 0;
+    this->yFirst = this->nextStart;
+    this->windowDimensions[0] = this->xdim;
+    this->windowDimensions[1] = num;
+    this->windowDimensions[2] = this->zdim;
+
+    size_t slabSize = num*this->xdim;
+    for(size_t z=0;z<this->zdim;z++){
+      float *slab = this->array + z*this->xySize + this->yFirst*this->xdim;
+      for(size_t i=0;i<slabSize;i++){
+	this->work[z*slabSize+i] = slab[i];
+	this->mask[z*slabSize+i] = !this->par.isBlank(slab[i]);
+      }
+    }
+
+    if(this->smoothType=="recursive")
+      this->recursiveGauss.smoothSpectra(&this->work[0], &this->smoothed[0], slabSize, this->zdim, this->mask, this->numThreads);
+    else
+      this->hann.smoothSpectra(&this->work[0], &this->smoothed[0], slabSize, this->zdim, this->mask, this->numThreads);
+  }
+
+  this->nextStart += num;
+  return true;
+}
+//-----------------------------------------------------------
+
+bool Cube::canStreamSmoothing(std::string &reason)
 {
+  /// @details
+  ///  Can the smoothed search be done a window at a time, by
+  ///  Cube::StreamSmoothSearch()? This is not possible if anything
+  ///  other than the search itself needs the whole smoothed cube, or
+  ///  if the smoothing and the search need different sorts of
+  ///  window: channel maps are searched a block of channels at a
+  ///  time, which the recursive filter cannot do as it needs whole
+  ///  spectra, and spectra are searched a slab of rows at a time,
+  ///  which the spatial smoothing cannot do as it needs whole channel
+  ///  maps.
+  /// \param reason Set to the reason it is not possible.
+  /// \return True if the search can be done a window at a time.
+
+  std::string smoothType = this->par.getSmoothType();
+  if(this->par.getFlagOutputSmooth())
+    reason = "the smoothed cube is to be saved";
+  else if(this->par.getFlagSmoothExists())
+    reason = "the smoothed cube is to be read from a file";
+  else if(this->par.getFlagFDR())
+    reason = "the FDR method needs the whole smoothed cube";
+  else if(this->par.getFlagGrowth())
+    reason = "growing the detections needs the whole smoothed cube";
+  else if(this->par.getSearchType()!="spectral" && smoothType=="recursive")
+    reason = "recursive smoothing cannot be done a block of channels at a time";
+  else if(this->par.getSearchType()=="spectral" && (smoothType=="spatial" || smoothType=="3D"))
+    reason = "spatial smoothing cannot be done a slab of rows at a time";
+  else return true;
+  return false;
+}
+//-----------------------------------------------------------
 
+void Cube::calcSmoothedStats(const std::vector<bool> &mask)
+{
+  /// @details
+  ///  Finds the statistics of the smoothed cube, for use when the
+  ///  smoothed cube is not being kept. The cube is smoothed a window
+  ///  at a time by a SmoothingSweep, and the values are gathered as
+  ///  they go: the mean and standard deviation from sums over the
+  ///  first sweep, and the median and MADFM with StreamingMedian
+  ///  objects, which need a few sweeps each. The results are the same
+  ///  as those StatsContainer::calculate() would give for the whole
+  ///  smoothed cube (the mean and standard deviation may differ by
+  ///  rounding when the spectra are being searched, as the values are
+  ///  then summed in a different order).
+  ///
+  ///  Any memory left in the Param::smoothMemory budget, after the
+  ///  cube and the windows, is used to let the StreamingMedian
+  ///  objects keep more values, so that fewer sweeps are needed.
+  /// \param mask The pixels to use. If empty, all pixels are used.
+
+  SmoothingSweep sweep(this->array, this->axisDim, this->par);
+  bool useMask = (mask.size()>0);
+  size_t xdim = this->axisDim[0];
   size_t xySize = this->axisDim[0]*this->axisDim[1];
+
+  size_t capacity = 1048576;
+  double budget = this->par.getSmoothMemory()*1024.*1024.;
+  double needed = double(this->numPixels)*sizeof(float) + double(mask.size()/8) + double(sweep.memoryUsage())
+    + double(Statistics::StreamingMedian::memoryUsage(capacity));
+  if(budget > needed) capacity += size_t((budget-needed)/sizeof(float));
+
+  // The first sweep finds the range of the values for the median,
+  // and the sums for the mean and standard deviation, accumulated
+  // as findMean() and findStddev() do.
+  double sumx=0.,sumxx=0.;
+  size_t goodSize=0;
+  float minVal=0.,maxVal=0.;
+  bool firstSweep=true;
+  Statistics::StreamingMedian findMed(capacity);
+  while(findMed.needsPass()){
+    findMed.startPass();
+    sweep.start();
+    while(sweep.next()){
+      float *window = sweep.window();
+      size_t *wdim = sweep.windowDim();
+      size_t i=0;
+      for(size_t z=sweep.firstChannel();z<sweep.firstChannel()+wdim[2];z++){
+	for(size_t y=sweep.firstRow();y<sweep.firstRow()+wdim[1];y++){
+	  size_t pos = z*xySize + y*xdim;
+	  for(size_t x=0;x<xdim;x++,pos++,i++){
+	    if(!useMask || mask[pos]){
+	      float value = window[i];
+	      findMed.add(value);
+	      if(firstSweep){
+		sumx += value;
+		sumxx += (value*value);
+		if(goodSize==0 || value<minVal) minVal = value;
+		if(goodSize==0 || value>maxVal) maxVal = value;
+		goodSize++;
+	      }
+	    }
+	  }
+	}
+      }
+    }
+    findMed.endPass();
+    firstSweep = false;
+  }
+
+  if(goodSize==0){
+    DUCHAMPERROR("calcSmoothedStats","There are no good pixels in the smoothed cube! Cannot calculate stats!");
+    return;
+  }
+
+  float mean = float(sumx/double(goodSize));
+  double smean = sumx/double(goodSize);
+  float stddev = float(sqrt(sumxx/double(goodSize) - smean*smean));
+  float median = findMed.getMedian();
+
+  // The absolute deviations from the median all lie below the larger
+  // of those of the extreme values.
+  Statistics::StreamingMedian findMadfm(capacity);
+  findMadfm.setRange(0., std::max(absval(maxVal-median),absval(minVal-median)));
+  while(findMadfm.needsPass()){
+    findMadfm.startPass();
+    sweep.start();
+    while(sweep.next()){
+      float *window = sweep.window();
+      size_t *wdim = sweep.windowDim();
+      size_t i=0;
+      for(size_t z=sweep.firstChannel();z<sweep.firstChannel()+wdim[2];z++){
+	for(size_t y=sweep.firstRow();y<sweep.firstRow()+wdim[1];y++){
+	  size_t pos = z*xySize + y*xdim;
+	  for(size_t x=0;x<xdim;x++,pos++,i++)
+	    if(!useMask || mask[pos]) findMadfm.add(absval(window[i]-median));
+	}
+      }
+    }
+    findMadfm.endPass();
+  }
+  float madfm = findMadfm.getMedian();
+
+  this->Stats.define(mean,median,stddev,madfm);
+}
+//-----------------------------------------------------------
+
+void Cube::StreamSmoothSearch()
+{
+  /// @details
+  ///  Smooths and searches the cube, as Cube::SmoothSearch() does, but
+  ///  without keeping the whole of the smoothed cube. This is used
+  ///  when the recon array has not been allocated, as keeping the
+  ///  smoothed cube would go over the Param::smoothMemory budget (see
+  ///  Cube::initialiseCube()).
+  ///
+  ///  The statistics are found first, by Cube::setCubeStats() (which
+  ///  calls Cube::calcSmoothedStats()), unless a threshold has been
+  ///  given. The cube is then smoothed once more, a window at a time
+  ///  (see SmoothingSweep), and each window is searched as soon as it
+  ///  has been smoothed: the channel maps of a block of channels in
+  ///  the same way as search3DArraySpatial() does (or given to a
+  ///  RunLabeller, as search3DArrayConnected() does), or the spectra
+  ///  of a slab of rows as search3DArraySpectral() does. The windows
+  ///  are taken in order, so the detections are found in the same
+  ///  order and the list is the same as that of Cube::SmoothSearch().
+  ///
+  ///  As the smoothed cube is not kept, the smallest and largest
+  ///  smoothed values of each detection are recorded (with
+  ///  Detection::setSearchRange()) while its window is being
+  ///  searched. The largest is used for the peak signal-to-noise
+  ///  ratio, which is then the same as that found from the recon
+  ///  array by Cube::SmoothSearch(). If the cube is inverted (for a
+  ///  negative search), the recon array would be too, and the
+  ///  smallest value, made negative, becomes the peak.
+  ///
+  ///  If this cannot be done (see Cube::canStreamSmoothing()), the
+  ///  recon array is allocated and Cube::SmoothSearch() used instead.
+
+  std::string reason;
+  if(!this->canStreamSmoothing(reason)){
+    DUCHAMPWARN("StreamSmoothSearch","Cannot smooth and search the cube a window at a time, as " << reason << ". Smoothing the whole cube.");
+    this->recon = new float[this->numPixels];
+    this->reconAllocated = true;
+    this->SmoothSearch();
+    return;
+  }
+
   size_t xdim = this->axisDim[0];
   size_t ydim = this->axisDim[1];
   size_t zdim = this->axisDim[2];
-  int numFound=0;
-  ProgressBar bar;
 
-  GaussSmooth2D<float> gauss(this->par.getKernMaj(),
-			   this->par.getKernMin(),
-			   this->par.getKernPA());
+  if(this->par.isVerbose()) std::cout << "  ";
 
-  this->Stats.scaleNoise(1./gauss.getStddevScale());
-  if(this->par.getFlagFDR()) this->setupFDR();
+  this->setCubeStats();
 
-  if(this->par.isVerbose()) {
-    std::cout<<"  Smoothing spatially & searching... " << std::flush;
-    bar.init(zdim);
-  }
+  if(this->par.isVerbose()) std::cout << "  Smoothing & searching... " << std::flush;
 
+  SmoothingSweep sweep(this->array, this->axisDim, this->par);
   std::vector <Detection> outputList;
-  size_t *imdim = new size_t[2];
-  imdim[0] = xdim; imdim[1] = ydim;
-  Image *channelImage = new Image(imdim);
-  delete [] imdim;
-  channelImage->saveParam(this->par);
-  channelImage->saveStats(this->Stats);
-  channelImage->setMinSize(1);
-
-  float *image = new float[xySize];
-  float *smoothed=0;
-  float median,madfm;//,threshold;
-  for(size_t z=0;z<zdim;z++){
-
-    if( this->par.isVerbose() ) bar.update(z+1);
-      
-    if(!this->par.isFlaggedChannel(z)){
+  DetectionGrid grid;
+  if(this->par.getFlagTwoStageMerging()) grid.define(this->axisDim,this->par);
+  int numFound=0;
+  ProgressBar bar;
+  bool useBar = this->par.isVerbose() && (sweep.numWindows() > 1);
+  if(useBar) bar.init(sweep.numWindows());
+  size_t numDone=0;
+
+  if(this->par.getSearchType()=="spatial"){
+
+    size_t imdim[2] = {xdim, ydim};
+    Image channelImage(imdim);
+    channelImage.saveParam(this->par);
+    channelImage.saveStats(this->Stats);
+    channelImage.setMinSize(1);
+
+    sweep.start();
+    while(sweep.next()){
+      size_t *wdim = sweep.windowDim();
+      for(size_t i=0;i<wdim[2];i++){
+	size_t z = sweep.firstChannel()+i;
+	if(!this->par.isFlaggedChannel(z)){
+	  float *channel = sweep.window()+i*xdim*ydim;
+	  channelImage.extractImage(sweep.window(),wdim,i);
+	  std::vector<PixelInfo::Object2D> objlist = channelImage.findSources2D();
+	  std::vector<PixelInfo::Object2D>::iterator obj;
+	  numFound += objlist.size();
+	  for(obj=objlist.begin();obj!=objlist.end();obj++){
+	    Detection newObject;
+	    newObject.addChannel(z,*obj);
+	    newObject.setOffsets(this->par);
+	    float min = channel[obj->getScan(0).getY()*xdim + obj->getScan(0).getX()], peak = min;
+	    for(long s=0;s<obj->getNumScan();s++){
+	      PixelInfo::Scan scan = obj->getScan(s);
+	      for(long x=scan.getX();x<=scan.getXmax();x++){
+		min = std::min(min,channel[scan.getY()*xdim+x]);
+		peak = std::max(peak,channel[scan.getY()*xdim+x]);
+	      }
+	    }
+	    newObject.setSearchRange(min,peak);
+	    if(this->par.getFlagTwoStageMerging()) mergeIntoList(newObject,outputList,this->par,grid);
+	    else outputList.push_back(newObject);
+	  }
+	}
+      }
+      if(useBar) bar.update(++numDone);
+    }
 
-      for(size_t pix=0;pix<xySize;pix++) image[pix] = this->array[z*xySize+pix];
+  }
+  else if(this->par.getSearchType()=="3D"){
 
-      std::vector<bool> mask  = this->par.makeBlankMask(image+z*xySize,xySize);
+    RunLabeller labeller(xdim,ydim,this->par);
 
-      smoothed = gauss.smooth(image,xdim,ydim,mask);
-      
-      findMedianStats(smoothed,xySize,mask,median,madfm);
-
-      channelImage->saveArray(smoothed,xySize);
-
-      std::vector<PixelInfo::Object2D> objlist = channelImage->findSources2D();
-      std::vector<PixelInfo::Object2D>::iterator obj;
-      numFound += objlist.size();
-      for(obj=objlist.begin();obj<objlist.end();obj++){
-	Detection newObject;
-	newObject.addChannel(z,*obj);
-	newObject.setOffsets(this->par);
-	mergeIntoList(newObject,outputList,this->par);
+    sweep.start();
+    while(sweep.next()){
+      size_t *wdim = sweep.windowDim();
+      for(size_t i=0;i<wdim[2];i++){
+	size_t z = sweep.firstChannel()+i;
+	if(!this->par.isFlaggedChannel(z))
+	  labeller.addChannel(sweep.window()+i*xdim*ydim,z,this->Stats);
       }
+      if(useBar) bar.update(++numDone);
+    }
 
+    outputList = labeller.getObjects();
+    numFound = outputList.size();
+
+  }
+  else if(zdim>1){
+
+    size_t specdim[2] = {zdim, 1};
+    Image spectrum(specdim);
+    spectrum.saveParam(this->par);
+    spectrum.saveStats(this->Stats);
+    spectrum.setMinSize(1);
+
+    sweep.start();
+    while(sweep.next()){
+      float *window = sweep.window();
+      size_t *wdim = sweep.windowDim();
+      size_t slabSize = wdim[0]*wdim[1];
+      for(size_t npix=0;npix<slabSize;npix++){
+	bool doPixel = false;
+	for(size_t z=0;z<zdim;z++)
+	  doPixel = doPixel || (!this->par.isBlank(window[npix+slabSize*z]) && !this->par.isFlaggedChannel(z));
+	if(doPixel){
+	  size_t x = npix % xdim;
+	  size_t y = sweep.firstRow() + npix/xdim;
+	  spectrum.extractSpectrum(window,wdim,npix);
+	  spectrum.removeFlaggedChannels();
+	  std::vector<PixelInfo::Scan> objlist = spectrum.findSources1D();
+	  std::vector<PixelInfo::Scan>::iterator obj;
+	  numFound += objlist.size();
+	  for(obj=objlist.begin();obj<objlist.end();obj++){
+	    Detection newObject;
+	    float min = window[npix+slabSize*obj->getX()], peak = min;
+	    for(int z=obj->getX();z<=obj->getXmax();z++){
+	      newObject.addPixel(x,y,z);
+	      min = std::min(min,window[npix+slabSize*z]);
+	      peak = std::max(peak,window[npix+slabSize*z]);
+	    }
+	    newObject.setOffsets(this->par);
+	    newObject.setSearchRange(min,peak);
+	    if(this->par.getFlagTwoStageMerging()) mergeIntoList(newObject,outputList,this->par,grid);
+	    else outputList.push_back(newObject);
+	  }
+	}
+      }
+      if(useBar) bar.update(++numDone);
     }
-    
+
   }
 
-  delete [] smoothed;
-  delete [] image;
-  delete channelImage;
-    
-  //   this->reconExists = true;
-  if(par.isVerbose()){
-    bar.fillSpace("Found ");
-    std::cout << numFound << ".\n";
+  if(this->par.isVerbose()){
+    if(useBar) bar.remove();
+    std::cout << "Found " << numFound << ".\n";
+  }
+
+  *(this->objectList) = outputList;
+
+  if(this->par.isVerbose()) std::cout << "  Updating detection map... " 
+				      << std::flush;
+  this->updateDetectMap();
+  if(this->par.isVerbose()) std::cout << "Done.\n";
+
+  if(this->par.getFlagLog()){
+    if(this->par.isVerbose()) 
+      std::cout << "  Logging intermediate detections... " << std::flush;
+    this->logDetectionList();
+    if(this->par.isVerbose()) std::cout << "Done.\n";
   }
-    
-  *this->objectList = outputList;
 
 }
 
@@ -155,7 +155,7 @@ namespace duchamp
 		    this->detectMap = newdetect;
 
 		    if(this->par.isVerbose()) bar.update(4);
-		    if(this->par.getFlagATrous() || this->par.getFlagSmooth()){
+		    if(this->reconAllocated){
 			// Trim the reconstructed array if we are going to do the
 			// reconstruction or smooth the array
 			float *newrecon  = new float[this->numPixels];
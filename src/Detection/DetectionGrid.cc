@@ -0,0 +1,258 @@
+// -----------------------------------------------------------------------
+// DetectionGrid.cc: Member functions for the DetectionGrid class.
+// -----------------------------------------------------------------------
+// Copyright (C) 2006, Matthew Whiting, ATNF
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or (at your
+// option) any later version.
+//
+// Duchamp is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Duchamp; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA
+//
+// Correspondence concerning Duchamp may be directed to:
+//    Internet email: Matthew.Whiting [at] atnf.csiro.au
+//    Postal address: Dr. Matthew Whiting
+//                    Australia Telescope National Facility, CSIRO
+//                    PO Box 76
+//                    Epping NSW 1710
+//                    AUSTRALIA
+// -----------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <duchamp/duchamp.hh>
+#include <duchamp/param.hh>
+#include <duchamp/Detection/detection.hh>
+#include <duchamp/Detection/DetectionGrid.hh>
+
+namespace duchamp {
+
+  DetectionGrid::DetectionGrid()
+  {
+    for(int i=0;i<3;i++){
+      this->itsOrigin[i] = 0;
+      this->itsCellSize[i] = 1;
+      this->itsNumCells[i] = 1;
+      this->itsGap[i] = 0;
+    }
+    this->itsCells = std::vector< std::vector<size_t> >(1);
+  }
+  //--------------------------------------------------------------------
+
+  DetectionGrid::DetectionGrid(std::vector<Detection> &objList, Param &par)
+  {
+    /// @details
+    /// Defines the grid with define(), and adds all the Detections
+    /// in the list.
+    /// \param objList The list of Detections.
+    /// \param par The parameters, giving the merging thresholds.
+
+    this->define(objList,par);
+    for(size_t i=0;i<objList.size();i++) this->add(i,objList[i]);
+  }
+  //--------------------------------------------------------------------
+
+  DetectionGrid::DetectionGrid(size_t *dim, Param &par)
+  {
+    /// @details
+    /// Defines an empty grid covering an array, with define().
+    /// \param dim The dimensions of the array (three values).
+    /// \param par The parameters, giving the merging thresholds.
+
+    this->define(dim,par);
+  }
+  //--------------------------------------------------------------------
+
+  void DetectionGrid::setGaps(Param &par)
+  {
+    // The same expansion as Detection::isNear(), but never negative.
+    long gapS = par.getFlagAdjacent() ? 1 : long(ceil(par.getThreshS()));
+    long gapV = long(ceil(par.getThreshV()));
+    this->itsGap[0] = this->itsGap[1] = std::max(gapS,0L);
+    this->itsGap[2] = std::max(gapV,0L);
+  }
+  //--------------------------------------------------------------------
+
+  void DetectionGrid::makeCells(long *low, long *high, double maxCells)
+  {
+    /// @details
+    /// Sets up empty cells covering the range [low,high] along each
+    /// axis, starting from the cell sizes already set. If there
+    /// would be more than maxCells cells, the size of the cells
+    /// along the axis with the most of them is doubled until there
+    /// are few enough.
+
+    for(int a=0;a<3;a++){
+      this->itsOrigin[a] = low[a];
+      this->itsNumCells[a] = (high[a]-low[a])/this->itsCellSize[a] + 1;
+    }
+    while(double(this->itsNumCells[0])*double(this->itsNumCells[1])*double(this->itsNumCells[2]) > maxCells){
+      int a=0;
+      if(this->itsNumCells[1]>this->itsNumCells[a]) a=1;
+      if(this->itsNumCells[2]>this->itsNumCells[a]) a=2;
+      this->itsCellSize[a] *= 2;
+      this->itsNumCells[a] = (high[a]-low[a])/this->itsCellSize[a] + 1;
+    }
+
+    this->itsCells = std::vector< std::vector<size_t> >(this->itsNumCells[0]*this->itsNumCells[1]*this->itsNumCells[2]);
+    this->itsCellRange.clear();
+  }
+  //--------------------------------------------------------------------
+
+  void DetectionGrid::define(std::vector<Detection> &objList, Param &par)
+  {
+    /// @details
+    /// Sets up an empty grid covering the bounding boxes of a list
+    /// of Detections. The cells are made as large as the average
+    /// box plus the merging threshold along each axis, so a box
+    /// typically covers only a few cells, but there are never more
+    /// cells than a few per Detection.
+    /// \param objList The list of Detections.
+    /// \param par The parameters, giving the merging thresholds.
+
+    this->setGaps(par);
+
+    long low[3]={0,0,0}, high[3]={0,0,0};
+    double meanSize[3] = {0.,0.,0.};
+    for(size_t i=0;i<objList.size();i++){
+      long boxMin[3] = {objList[i].getXmin(), objList[i].getYmin(), objList[i].getZmin()};
+      long boxMax[3] = {objList[i].getXmax(), objList[i].getYmax(), objList[i].getZmax()};
+      for(int a=0;a<3;a++){
+	if(i==0 || boxMin[a]<low[a]) low[a] = boxMin[a];
+	if(i==0 || boxMax[a]>high[a]) high[a] = boxMax[a];
+	meanSize[a] += boxMax[a]-boxMin[a]+1;
+      }
+    }
+
+    for(int a=0;a<3;a++){
+      if(objList.size()>0) meanSize[a] /= double(objList.size());
+      this->itsCellSize[a] = std::max(long(ceil(meanSize[a])) + this->itsGap[a], 1L);
+    }
+
+    this->makeCells(low, high, 4.*double(objList.size()) + 64.);
+  }
+  //--------------------------------------------------------------------
+
+  void DetectionGrid::define(size_t *dim, Param &par)
+  {
+    /// @details
+    /// Sets up an empty grid covering an array, for when the
+    /// Detections are not known in advance. The cells are a few
+    /// pixels and channels across (more if the merging thresholds
+    /// are large), with no more than about a quarter of a million
+    /// of them.
+    /// \param dim The dimensions of the array (three values).
+    /// \param par The parameters, giving the merging thresholds.
+
+    this->setGaps(par);
+
+    long low[3]={0,0,0}, high[3];
+    long minSize[3]={8,8,4};
+    for(int a=0;a<3;a++){
+      high[a] = std::max(long(dim[a])-1, 0L);
+      this->itsCellSize[a] = std::max(2*this->itsGap[a]+1, minSize[a]);
+    }
+
+    this->makeCells(low, high, 262144.);
+  }
+  //--------------------------------------------------------------------
+
+  void DetectionGrid::cellRange(int axis, long low, long high, long &first, long &last)
+  {
+    /// @details
+    /// Finds the first and last cells along an axis that are covered
+    /// by the range [low,high]. Values outside the grid fall in the
+    /// cells at its edges.
+
+    long lastCell = this->itsNumCells[axis]-1;
+    first = (low - this->itsOrigin[axis]);
+    last  = (high - this->itsOrigin[axis]);
+    first = (first<0) ? 0 : std::min(first/this->itsCellSize[axis], lastCell);
+    last  = (last<0)  ? 0 : std::min(last/this->itsCellSize[axis], lastCell);
+  }
+  //--------------------------------------------------------------------
+
+  void DetectionGrid::add(size_t id, Detection &obj)
+  {
+    /// @details
+    /// Lists a Detection in all the cells its bounding box covers.
+    /// If it has been added before, it is only added to those cells
+    /// that it was not already listed in.
+    /// \param id The position of the Detection in the list.
+    /// \param obj The Detection.
+
+    if(this->itsCellRange.size() < 6*(id+1)){
+      // Detections not yet added cover no cells: first>last.
+      size_t oldSize = this->itsCellRange.size();
+      this->itsCellRange.resize(6*(id+1));
+      for(size_t i=oldSize;i<this->itsCellRange.size();i+=2){
+	this->itsCellRange[i] = 1;
+	this->itsCellRange[i+1] = 0;
+      }
+    }
+    long *old = &this->itsCellRange[6*id];
+
+    long first[3], last[3];
+    this->cellRange(0, obj.getXmin(), obj.getXmax(), first[0], last[0]);
+    this->cellRange(1, obj.getYmin(), obj.getYmax(), first[1], last[1]);
+    this->cellRange(2, obj.getZmin(), obj.getZmax(), first[2], last[2]);
+    for(long z=first[2];z<=last[2];z++){
+      bool zOld = (z>=old[4] && z<=old[5]);
+      for(long y=first[1];y<=last[1];y++){
+	bool yOld = zOld && (y>=old[2] && y<=old[3]);
+	for(long x=first[0];x<=last[0];x++){
+	  if(yOld && x>=old[0] && x<=old[1]) continue;
+	  this->itsCells[(z*this->itsNumCells[1]+y)*this->itsNumCells[0]+x].push_back(id);
+	}
+      }
+    }
+
+    for(int a=0;a<3;a++){
+      // Keep the union of the old and new ranges, as the Detection
+      // is still listed in the old cells.
+      if(old[2*a]<=old[2*a+1]){
+	first[a] = std::min(first[a],old[2*a]);
+	last[a] = std::max(last[a],old[2*a+1]);
+      }
+      old[2*a] = first[a];
+      old[2*a+1] = last[a];
+    }
+  }
+  //--------------------------------------------------------------------
+
+  void DetectionGrid::findCandidates(Detection &obj, std::vector<size_t> &ids)
+  {
+    /// @details
+    /// Finds every Detection listed in the cells covered by the
+    /// bounding box of a Detection, expanded by the merging
+    /// thresholds. These include all those for which obj.isNear()
+    /// is true. Any Detection that has been removed from the list,
+    /// or that is obj itself, needs to be skipped by the caller.
+    /// \param obj The Detection to search around.
+    /// \param ids The positions of the Detections found, in
+    /// increasing order, with no repeats.
+
+    ids.clear();
+    long first[3], last[3];
+    this->cellRange(0, obj.getXmin()-this->itsGap[0], obj.getXmax()+this->itsGap[0], first[0], last[0]);
+    this->cellRange(1, obj.getYmin()-this->itsGap[1], obj.getYmax()+this->itsGap[1], first[1], last[1]);
+    this->cellRange(2, obj.getZmin()-this->itsGap[2], obj.getZmax()+this->itsGap[2], first[2], last[2]);
+    for(long z=first[2];z<=last[2];z++)
+      for(long y=first[1];y<=last[1];y++)
+	for(long x=first[0];x<=last[0];x++){
+	  std::vector<size_t> &cell = this->itsCells[(z*this->itsNumCells[1]+y)*this->itsNumCells[0]+x];
+	  ids.insert(ids.end(), cell.begin(), cell.end());
+	}
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  }
+
+}
@@ -0,0 +1,102 @@
+// -----------------------------------------------------------------------
+// DetectionGrid.hh: Definition of the DetectionGrid class, a grid
+//                   index of the bounding boxes of a list of
+//                   Detections.
+// -----------------------------------------------------------------------
+// Copyright (C) 2006, Matthew Whiting, ATNF
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or (at your
+// option) any later version.
+//
+// Duchamp is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Duchamp; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA
+//
+// Correspondence concerning Duchamp may be directed to:
+//    Internet email: Matthew.Whiting [at] atnf.csiro.au
+//    Postal address: Dr. Matthew Whiting
+//                    Australia Telescope National Facility, CSIRO
+//                    PO Box 76
+//                    Epping NSW 1710
+//                    AUSTRALIA
+// -----------------------------------------------------------------------
+#ifndef DETECTION_GRID_H
+#define DETECTION_GRID_H
+
+#include <vector>
+#include <duchamp/duchamp.hh>
+#include <duchamp/param.hh>
+#include <duchamp/Detection/detection.hh>
+
+namespace duchamp {
+
+  /// @brief An index of the bounding boxes of a list of Detections,
+  /// used to find those that might be merged with a given one.
+  /// @details The space covered by the Detections is divided into a
+  /// regular grid of cells, and each Detection is listed in every
+  /// cell that its bounding box covers. The Detections that could be
+  /// merged with a given one are then found by looking only in the
+  /// cells covered by its bounding box, expanded by the merging
+  /// thresholds in the same way as Detection::isNear() does. This
+  /// gives every Detection for which isNear() is true, and usually
+  /// few others, so it can be used to avoid comparing every pair of
+  /// Detections without changing the result.
+  ///
+  /// Detections are referred to by their position in the list. A
+  /// Detection that has grown is added again, and is then listed in
+  /// the cells its new box covers as well (the cells it was in
+  /// before are still covered by its new box). This lets the grid
+  /// follow a list that is being built up a Detection at a time, as
+  /// by mergeIntoList(). Boxes that lie outside the grid are put in
+  /// the cells at its edge, so any Detection can be added, but the
+  /// index works best when the grid is defined to suit the
+  /// Detections that will be added.
+  class DetectionGrid
+  {
+  public:
+    /// @brief Default constructor, giving a single cell.
+    DetectionGrid();
+    /// @brief Constructor, defining the grid from a list of Detections and indexing them all.
+    DetectionGrid(std::vector<Detection> &objList, Param &par);
+    /// @brief Constructor, defining an empty grid to cover an array.
+    DetectionGrid(size_t *dim, Param &par);
+    /// @brief Destructor
+    virtual ~DetectionGrid(){};
+
+    /// @brief Choose the grid to suit a list of Detections.
+    void   define(std::vector<Detection> &objList, Param &par);
+    /// @brief Choose the grid to cover an array.
+    void   define(size_t *dim, Param &par);
+    /// @brief Add a Detection, at a given position in the list, or update it if it has grown.
+    void   add(size_t id, Detection &obj);
+    /// @brief Find the Detections whose boxes are near that of a given Detection.
+    void   findCandidates(Detection &obj, std::vector<size_t> &ids);
+    /// @brief The number of cells in the grid.
+    size_t getNumCells(){return itsCells.size();};
+
+  protected:
+    /// @brief Set the gaps used when searching, from the merging thresholds.
+    void   setGaps(Param &par);
+    /// @brief Set up the cells, given the origin and extent of the grid and starting cell sizes.
+    void   makeCells(long *low, long *high, double maxCells);
+    /// @brief The range of cells covered by a box, along one axis.
+    void   cellRange(int axis, long low, long high, long &first, long &last);
+
+    long   itsOrigin[3];              ///< The lowest x, y and z values of the grid.
+    long   itsCellSize[3];            ///< The size of the cells along each axis.
+    long   itsNumCells[3];            ///< The number of cells along each axis.
+    long   itsGap[3];                 ///< The distance boxes are expanded by when searching.
+    std::vector< std::vector<size_t> > itsCells;  ///< The Detections listed in each cell.
+    std::vector<long> itsCellRange;   ///< The first and last cell along each axis listing each Detection.
+  };
+
+}
+
+#endif
@@ -0,0 +1,240 @@
+// -----------------------------------------------------------------------
+// RunLabeller.cc: Implementation of the RunLabeller class.
+// -----------------------------------------------------------------------
+// Copyright (C) 2006, Matthew Whiting, ATNF
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or (at your
+// option) any later version.
+//
+// Duchamp is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Duchamp; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA
+//
+// Correspondence concerning Duchamp may be directed to:
+//    Internet email: Matthew.Whiting [at] atnf.csiro.au
+//    Postal address: Dr. Matthew Whiting
+//                    Australia Telescope National Facility, CSIRO
+//                    PO Box 76
+//                    Epping NSW 1710
+//                    AUSTRALIA
+// -----------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <duchamp/duchamp.hh>
+#include <duchamp/param.hh>
+#include <duchamp/Detection/RunLabeller.hh>
+#include <duchamp/Detection/detection.hh>
+#include <duchamp/Detection/finders.hh>
+#include <duchamp/PixelMap/Scan.hh>
+#include <duchamp/PixelMap/Object2D.hh>
+#include <duchamp/Utils/Statistics.hh>
+
+using namespace PixelInfo;
+
+namespace duchamp {
+
+  RunLabeller::RunLabeller(size_t xdim, size_t ydim, Param &par)
+  {
+    /// @details
+    /// \param xdim The x-dimension of the channel maps.
+    /// \param ydim The y-dimension of the channel maps.
+    /// \param par The parameters. The merging criteria are taken
+    /// from flagAdjacent, threshSpatial and threshVelocity, and the
+    /// BLANK pixel definition is used when finding the runs.
+
+    this->itsPar = par;
+    this->itsXdim = xdim;
+    this->itsYdim = ydim;
+    this->itsFlagAdj = par.getFlagAdjacent();
+    this->itsThreshS = par.getThreshS();
+    float threshV = par.getThreshV();
+
+    // The same limits as Detection::isNear(): runs further apart
+    // than these cannot be merged.
+    if(this->itsFlagAdj) this->itsSpatialGap = 1;
+    else this->itsSpatialGap = std::max(long(ceil(this->itsThreshS)),0L);
+    this->itsVelocityGap = (threshV>=0.) ? long(floor(threshV)) : -1;
+
+    // The rows of the current channel and the itsVelocityGap before
+    // it are indexed, each channel in slot z%itsNumSlots.
+    this->itsNumSlots = std::max(this->itsVelocityGap,0L) + 1;
+    this->itsSlotChannel = std::vector<long>(this->itsNumSlots,-1);
+    this->itsRowStart = std::vector<size_t>(this->itsNumSlots*ydim,0);
+    this->itsRowEnd = std::vector<size_t>(this->itsNumSlots*ydim,0);
+  }
+  //--------------------------------------------------------------------
+
+  void RunLabeller::addChannel(float *image, long z, Statistics::StatsContainer<float> &stats)
+  {
+    /// @details
+    /// Finds the runs of detected pixels in each row of a channel
+    /// map, and joins them to the runs already found. A pixel is
+    /// detected if it is not BLANK and StatsContainer::isDetection()
+    /// says so, as for Image::findSources2D(), which also uses
+    /// thresholdRow() and maskToRuns(). Channels must be given
+    /// in increasing order, but need not all be given (flagged
+    /// channels can be left out).
+    /// \param image The channel map, of size xdim*ydim.
+    /// \param z The channel number.
+    /// \param stats The statistics that define what a detection is.
+
+    long slot = z % this->itsNumSlots;
+    this->itsSlotChannel[slot] = z;
+    size_t rowOffset = slot*this->itsYdim;
+
+    std::vector<unsigned char> mask(this->itsXdim);
+    std::vector<Scan> rowRuns;
+    for(size_t y=0;y<this->itsYdim;y++){
+      this->itsRowStart[rowOffset+y] = this->itsRowEnd[rowOffset+y] = this->itsRuns.size();
+      if(this->itsXdim==0) continue;
+      float *row = image + y*this->itsXdim;
+      thresholdRow(row, this->itsXdim, this->itsPar, stats, &mask[0]);
+      rowRuns.clear();
+      maskToRuns(&mask[0], this->itsXdim, y, rowRuns);
+      for(size_t i=0;i<rowRuns.size();i++){
+	float min = row[rowRuns[i].getX()], peak = min;
+	for(long x=rowRuns[i].getX()+1;x<=rowRuns[i].getXmax();x++){
+	  min = std::min(min,row[x]);
+	  peak = std::max(peak,row[x]);
+	}
+	this->addRun(rowRuns[i].getX(),rowRuns[i].getXmax(),y,z,min,peak);
+      }
+    }
+  }
+  //--------------------------------------------------------------------
+
+  bool RunLabeller::areJoined(const Run &first, const Run &second, long dz)
+  {
+    /// @details
+    /// Two runs are joined if they touch in the same channel (as the
+    /// pixels would be in the same object found by lutz_detect()), or
+    /// if Detection::isClose() would find them close enough to
+    /// merge. This is a check of the same conditions, done directly
+    /// on the two runs.
+    /// \param first The earlier run.
+    /// \param second The later run.
+    /// \param dz The channel separation of the runs.
+
+    long dy = labs(first.y-second.y);
+    long dx = std::max(0L, std::max(first.x-second.xmax, second.x-first.xmax));
+    if(dz==0 && dy<=1 && dx<=1) return true;
+    if(dz>this->itsVelocityGap || dy>this->itsSpatialGap) return false;
+    if(this->itsFlagAdj) return (dx<=1);
+    float sep = (dx>0) ? hypot(dx,dy) : fabs(dy);
+    return (sep <= this->itsThreshS);
+  }
+  //--------------------------------------------------------------------
+
+  void RunLabeller::addRun(long x, long xmax, long y, long z, float min, float peak)
+  {
+    /// @details
+    /// Adds a run to the list, and joins it to each earlier run in
+    /// the rows and channels that are within reach. The runs of each
+    /// row are in order of x, so only those close enough in x are
+    /// examined.
+    /// \param x The first pixel of the run.
+    /// \param xmax The last pixel of the run.
+    /// \param y The row.
+    /// \param z The channel.
+    /// \param min The smallest value in the run.
+    /// \param peak The largest value in the run.
+
+    Run run;
+    run.x = x;
+    run.xmax = xmax;
+    run.y = y;
+    run.z = z;
+    run.min = min;
+    run.peak = peak;
+    size_t index = this->itsRuns.size();
+    this->itsObjects.add();
+
+    long xReach = this->itsFlagAdj ? 1 : std::max(1L, long(floor(this->itsThreshS)));
+    for(long dz=0; dz<this->itsNumSlots && dz<=z; dz++){
+      long slot = (z-dz) % this->itsNumSlots;
+      if(this->itsSlotChannel[slot] != z-dz) continue;
+      // In the same channel, the runs touching this one must be
+      // looked at even if nothing is close enough to be merged.
+      long gap = (dz<=this->itsVelocityGap) ? this->itsSpatialGap : 0;
+      if(dz==0) gap = std::max(gap,1L);
+      long yLast = (dz==0) ? y : std::min(y+gap, long(this->itsYdim)-1);
+      for(long yy=std::max(y-gap,0L); yy<=yLast; yy++){
+	size_t rowOffset = slot*this->itsYdim + yy;
+	size_t r = this->itsRowStart[rowOffset];
+	size_t end = this->itsRowEnd[rowOffset];
+	while(r<end && this->itsRuns[r].xmax < x-xReach) r++;
+	for(; r<end && this->itsRuns[r].x <= xmax+xReach; r++){
+	  if(this->areJoined(this->itsRuns[r],run,dz)) this->itsObjects.join(r,index);
+	}
+      }
+    }
+
+    this->itsRuns.push_back(run);
+    this->itsRowEnd[(z%this->itsNumSlots)*this->itsYdim + y] = index+1;
+  }
+  //--------------------------------------------------------------------
+
+  std::vector<Detection> RunLabeller::getObjects()
+  {
+    /// @details
+    /// Gathers the runs of each object, and makes a Detection of
+    /// them, with the offsets set from the parameters, and the
+    /// smallest and largest values of the channel maps over the
+    /// object recorded with Detection::setSearchRange(). The objects
+    /// are listed in order of their first run (\ie by channel, row
+    /// and x of their first pixel), so the list does not depend on
+    /// the order in which runs were joined.
+    /// \return The list of objects.
+
+    size_t numRuns = this->itsRuns.size();
+    std::vector<size_t> label(numRuns);
+    size_t numObjects=0;
+    for(size_t i=0;i<numRuns;i++){
+      size_t root = this->itsObjects.findRoot(i);
+      if(root==i) label[i] = numObjects++;
+      else label[i] = label[root];
+    }
+
+    // Sort the runs by object, keeping them in order within each.
+    std::vector<size_t> first(numObjects+1,0), order(numRuns);
+    for(size_t i=0;i<numRuns;i++) first[label[i]+1]++;
+    for(size_t o=0;o<numObjects;o++) first[o+1] += first[o];
+    std::vector<size_t> next(first.begin(),first.end()-1);
+    for(size_t i=0;i<numRuns;i++) order[next[label[i]]++] = i;
+
+    std::vector<Detection> objList(numObjects);
+    for(size_t o=0;o<numObjects;o++){
+      Object2D channelMap;
+      long z = this->itsRuns[order[first[o]]].z;
+      float min = this->itsRuns[order[first[o]]].min;
+      float peak = this->itsRuns[order[first[o]]].peak;
+      for(size_t i=first[o];i<first[o+1];i++){
+	Run &run = this->itsRuns[order[i]];
+	min = std::min(min,run.min);
+	peak = std::max(peak,run.peak);
+	if(run.z != z){
+	  objList[o].addChannel(z,channelMap);
+	  channelMap = Object2D();
+	  z = run.z;
+	}
+	Scan scan(run.y,run.x,run.xmax-run.x+1);
+	channelMap.appendScan(scan);
+      }
+      objList[o].addChannel(z,channelMap);
+      objList[o].setOffsets(this->itsPar);
+      objList[o].setSearchRange(min,peak);
+    }
+
+    return objList;
+  }
+
+}
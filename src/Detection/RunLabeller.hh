@@ -0,0 +1,105 @@
+// -----------------------------------------------------------------------
+// RunLabeller.hh: Definition of the RunLabeller class, which finds the
+//                 objects in a cube that are connected in three
+//                 dimensions.
+// -----------------------------------------------------------------------
+// Copyright (C) 2006, Matthew Whiting, ATNF
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or (at your
+// option) any later version.
+//
+// Duchamp is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Duchamp; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA
+//
+// Correspondence concerning Duchamp may be directed to:
+//    Internet email: Matthew.Whiting [at] atnf.csiro.au
+//    Postal address: Dr. Matthew Whiting
+//                    Australia Telescope National Facility, CSIRO
+//                    PO Box 76
+//                    Epping NSW 1710
+//                    AUSTRALIA
+// -----------------------------------------------------------------------
+#ifndef RUN_LABELLER_H
+#define RUN_LABELLER_H
+
+#include <vector>
+#include <duchamp/duchamp.hh>
+#include <duchamp/param.hh>
+#include <duchamp/Detection/detection.hh>
+#include <duchamp/Detection/UnionFind.hh>
+#include <duchamp/Utils/Statistics.hh>
+
+namespace duchamp {
+
+  /// @brief A class to find the objects in a cube that are connected
+  /// in three dimensions.
+  /// @details The cube is given to the labeller a channel map at a
+  /// time, in order of channel. Each row of a map is scanned for runs
+  /// of detected pixels, and each run is joined to the earlier runs
+  /// that it would be merged with by Detection::canMerge() (\ie that
+  /// are within the threshSpatial/flagAdjacent and threshVelocity
+  /// limits), as well as to those it touches in the same channel,
+  /// using a union-find structure. Only the runs of the last few
+  /// channels need to be looked at, so the cost is proportional to
+  /// the number of runs. Once all channels have been given, the
+  /// objects are the sets of joined runs. They are the same as the
+  /// objects found by searching each channel map and merging the
+  /// detections with mergeList(), but no pairwise comparison of the
+  /// detections is needed.
+  class RunLabeller
+  {
+  public:
+    /// @brief Constructor, giving the size of the channel maps and the merging parameters
+    RunLabeller(size_t xdim, size_t ydim, Param &par);
+    /// @brief Destructor
+    virtual ~RunLabeller(){};
+
+    /// @brief Add the detected pixels of the next channel map.
+    void addChannel(float *image, long z, Statistics::StatsContainer<float> &stats);
+    /// @brief The number of runs of detected pixels found so far.
+    size_t getNumRuns(){return itsRuns.size();};
+    /// @brief Return the objects found, as a list of Detections.
+    std::vector<Detection> getObjects();
+
+  protected:
+    /// @brief A run of detected pixels in one row of a channel map.
+    struct Run {
+      long x;      ///< The first pixel of the run.
+      long xmax;   ///< The last pixel of the run.
+      long y;      ///< The row.
+      long z;      ///< The channel.
+      float min;   ///< The smallest value in the run.
+      float peak;  ///< The largest value in the run.
+    };
+
+    /// @brief Add a run, joining it to any earlier run it should be merged with.
+    void   addRun(long x, long xmax, long y, long z, float min, float peak);
+    /// @brief Should two runs be in the same object?
+    bool   areJoined(const Run &first, const Run &second, long dz);
+
+    Param  itsPar;                     ///< The parameters (for BLANK pixels and the offsets).
+    size_t itsXdim;                    ///< The x-dimension of the channel maps.
+    size_t itsYdim;                    ///< The y-dimension of the channel maps.
+    bool   itsFlagAdj;                 ///< Must the pixels be adjacent to be merged?
+    float  itsThreshS;                 ///< The spatial merging threshold.
+    long   itsSpatialGap;              ///< The largest row or column separation that can be merged.
+    long   itsVelocityGap;             ///< The largest channel separation that can be merged (-1 if none).
+    long   itsNumSlots;                ///< The number of channels whose rows are indexed.
+    std::vector<Run>    itsRuns;       ///< All the runs found so far, in order of channel, row and x.
+    UnionFind           itsObjects;    ///< The object containing each run.
+    std::vector<long>   itsSlotChannel;///< The channel indexed in each slot (-1 if none).
+    std::vector<size_t> itsRowStart;   ///< The first run of each row of the indexed channels.
+    std::vector<size_t> itsRowEnd;     ///< One past the last run of each row of the indexed channels.
+  };
+
+}
+
+#endif
@@ -0,0 +1,80 @@
+// -----------------------------------------------------------------------
+// UnionFind.cc: Member functions for the UnionFind class.
+// -----------------------------------------------------------------------
+// Copyright (C) 2006, Matthew Whiting, ATNF
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or (at your
+// option) any later version.
+//
+// Duchamp is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Duchamp; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA
+//
+// Correspondence concerning Duchamp may be directed to:
+//    Internet email: Matthew.Whiting [at] atnf.csiro.au
+//    Postal address: Dr. Matthew Whiting
+//                    Australia Telescope National Facility, CSIRO
+//                    PO Box 76
+//                    Epping NSW 1710
+//                    AUSTRALIA
+// -----------------------------------------------------------------------
+#include <vector>
+#include <duchamp/Detection/UnionFind.hh>
+
+namespace duchamp {
+
+  void UnionFind::resize(size_t size)
+  {
+    /// @details
+    /// \param size The new number of items.
+    size_t oldSize = this->itsParent.size();
+    this->itsParent.resize(size);
+    for(size_t i=oldSize;i<size;i++) this->itsParent[i] = i;
+  }
+  //--------------------------------------------------------------------
+
+  size_t UnionFind::findRoot(size_t item)
+  {
+    /// @details
+    /// Follows the links from an item to the root of its group,
+    /// making each item on the way link to the one two steps on.
+    /// \param item The item.
+    /// \return The root of its group.
+    while(this->itsParent[item]!=item){
+      this->itsParent[item] = this->itsParent[this->itsParent[item]];
+      item = this->itsParent[item];
+    }
+    return item;
+  }
+  //--------------------------------------------------------------------
+
+  size_t UnionFind::getRoot(size_t item) const
+  {
+    /// @details
+    /// \param item The item.
+    /// \return The root of its group.
+    while(this->itsParent[item]!=item) item = this->itsParent[item];
+    return item;
+  }
+  //--------------------------------------------------------------------
+
+  void UnionFind::join(size_t first, size_t second)
+  {
+    /// @details
+    /// The root of the joined group is the earlier of the two roots.
+    /// \param first One of the items.
+    /// \param second The other item.
+    size_t root1 = this->findRoot(first);
+    size_t root2 = this->findRoot(second);
+    if(root1<root2) this->itsParent[root2] = root1;
+    else if(root2<root1) this->itsParent[root1] = root2;
+  }
+
+}
@@ -0,0 +1,77 @@
+// -----------------------------------------------------------------------
+// UnionFind.hh: Definition of the UnionFind class, which gathers
+//               items into connected groups.
+// -----------------------------------------------------------------------
+// Copyright (C) 2006, Matthew Whiting, ATNF
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or (at your
+// option) any later version.
+//
+// Duchamp is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Duchamp; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA
+//
+// Correspondence concerning Duchamp may be directed to:
+//    Internet email: Matthew.Whiting [at] atnf.csiro.au
+//    Postal address: Dr. Matthew Whiting
+//                    Australia Telescope National Facility, CSIRO
+//                    PO Box 76
+//                    Epping NSW 1710
+//                    AUSTRALIA
+// -----------------------------------------------------------------------
+#ifndef UNION_FIND_H
+#define UNION_FIND_H
+
+#include <vector>
+#include <stddef.h>
+
+namespace duchamp {
+
+  /// @brief A union-find structure, to gather items (such as runs of
+  /// pixels, or detections) into connected groups.
+  /// @details Each item links to another in its group, and the links
+  /// lead to the root of the group, which is always its earliest
+  /// (lowest-numbered) item. So the groups, and their roots, do not
+  /// depend on the order in which the items were joined.
+  ///
+  /// findRoot() and join() shorten the links as they go, so must not
+  /// be used by two threads on the same group at once. getRoot() does
+  /// not change anything, so can be used by several threads while no
+  /// joins are being made.
+
+  class UnionFind
+  {
+  public:
+    UnionFind(){};
+    /// @brief Start with a number of items, each in a group of its own.
+    UnionFind(size_t size){resize(size);};
+    virtual ~UnionFind(){};
+
+    /// @brief The number of items.
+    size_t size(){return itsParent.size();};
+    /// @brief Change the number of items. Any new items are each in a group of their own.
+    void   resize(size_t size);
+    /// @brief Add an item, in a group of its own, and return its number.
+    size_t add(){itsParent.push_back(itsParent.size()); return itsParent.size()-1;};
+
+    /// @brief Find the root of the group containing an item, halving the path on the way.
+    size_t findRoot(size_t item);
+    /// @brief Find the root of the group containing an item, without changing the links.
+    size_t getRoot(size_t item) const;
+    /// @brief Put two items in the same group.
+    void   join(size_t first, size_t second);
+
+  private:
+    std::vector<size_t> itsParent;  ///< The item that each item links to.
+  };
+
+}
+
+#endif // UNION_FIND_H
@@ -29,6 +29,7 @@
 #include <iomanip>
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <string>
 #include <wcslib/wcs.h>
 #include <math.h>
@@ -62,6 +63,9 @@ namespace duchamp
     this->ypeak = 0;
     this->zpeak = 0;
     this->peakSNR = 0.;
+    this->searchPeak = 0.;
+    this->searchMin = 0.;
+    this->haveSearchPeak = false;
     this->xCentroid = 0.;
     this->yCentroid = 0.;
     this->zCentroid = 0.;
@@ -139,6 +143,9 @@ namespace duchamp
     this->ypeak        = d.ypeak;
     this->zpeak        = d.zpeak;
     this->peakSNR      = d.peakSNR;
+    this->searchPeak   = d.searchPeak;
+    this->searchMin    = d.searchMin;
+    this->haveSearchPeak = d.haveSearchPeak;
     this->xCentroid    = d.xCentroid;
     this->yCentroid    = d.yCentroid;
     this->zCentroid    = d.zCentroid;
@@ -266,17 +273,26 @@ namespace duchamp
   }
   //--------------------------------------------------------------------
 
-    void Detection::invert()
+    void Detection::invert(bool doSearchRange)
     {
 	/// @details
 	/// A front-end to simplify the inversion that is done at the Cube level.
 	/// The fluxes are made negative, and the negSource flag is flipped.
 	/// This can be used at any time - it doesn't matter which way the inversion is happening.
+	/// \param doSearchRange Whether to invert the range of values
+	/// found in the search as well. These are values of the array
+	/// searched, so should be inverted only when it is.
 
        this->negSource = true;
 	this->totalFlux = -1. * this->totalFlux;
 	this->intFlux = -1. * this->intFlux;
 	this->peakFlux = -1. * this->peakFlux;
+	if(doSearchRange && this->haveSearchPeak){
+	  // The peak of the inverted array is minus the minimum of the array searched.
+	  float peak = this->searchPeak;
+	  this->searchPeak = -1. * this->searchMin;
+	  this->searchMin = -1. * peak;
+	}
 
     }
 
@@ -1059,11 +1075,25 @@ namespace duchamp
   }
   //--------------------------------------------------------------------
   
+  void Detection::addSearchRange(float min, float peak)
+  {
+    /// @details
+    /// \param min The minimum value of the other range.
+    /// \param peak The peak value of the other range.
+    if(!this->haveSearchPeak) this->setSearchRange(min,peak);
+    else{
+      this->searchMin = std::min(this->searchMin,min);
+      this->searchPeak = std::max(this->searchPeak,peak);
+    }
+  }
+  //--------------------------------------------------------------------
+
   void Detection::addDetection(Detection &other)
   {
     for(std::map<long, Object2D>::iterator it = other.chanlist.begin(); it!=other.chanlist.end();it++)
       //      this->addChannel(*it);
       this->addChannel(it->first, it->second);
+    if(other.haveSearchPeak) this->addSearchRange(other.searchMin, other.searchPeak);
     this->haveParams = false; // make it appear as if the parameters haven't been calculated, so that we can re-calculate them  
   }
 
@@ -1072,6 +1102,7 @@ namespace duchamp
     Detection output = lhs;
     for(std::map<long, Object2D>::iterator it = rhs.chanlist.begin(); it!=rhs.chanlist.end();it++)
       output.addChannel(it->first, it->second);
+    if(rhs.haveSearchPeak) output.addSearchRange(rhs.searchMin, rhs.searchPeak);
     output.haveParams = false; // make it appear as if the parameters haven't been calculated, so that we can re-calculate them
     return output;
   }
@@ -42,6 +42,7 @@ using namespace PixelInfo;
 namespace duchamp
 {
 
+  class DetectionGrid;
 
   /// Class to represent a contiguous set of detected voxels.
   ///  This is a detected object, which features:
@@ -83,7 +84,7 @@ namespace duchamp
     void   calcFluxes(std::map<Voxel,float> &voxelMap);
 
       /// @brief Invert the source's flux values
-      void invert();
+      void invert(bool doSearchRange=true);
 
     /// @brief Calculate parameters related to the World Coordinate System. 
     //    void   calcWCSparams(float *fluxArray, long *dim, FitsHeader &head); 
@@ -205,6 +206,12 @@ namespace duchamp
     long        getZPeak(){return zpeak;};
     float       getPeakSNR(){return peakSNR;};
     void        setPeakSNR(float f){peakSNR = f;};
+    bool        hasSearchPeak(){return haveSearchPeak;};
+    float       getSearchPeak(){return searchPeak;};
+    float       getSearchMin(){return searchMin;};
+    void        setSearchRange(float min, float peak){searchMin = min; searchPeak = peak; haveSearchPeak = true;};
+    /// @brief Widen the search range to include another range (for when objects are merged).
+    void        addSearchRange(float min, float peak);
     float       getXCentroid(){return xCentroid;};
     float       getYCentroid(){return yCentroid;};
     float       getZCentroid(){return zCentroid;};
@@ -274,6 +281,9 @@ namespace duchamp
     long           ypeak;          ///< y-pixel location of peak flux
     long           zpeak;          ///< z-pixel location of peak flux
     float          peakSNR;        ///< signal-to-noise ratio at peak
+    float          searchPeak;     ///< peak value in the searched array, when that array is not kept (see Cube::StreamSmoothSearch())
+    float          searchMin;      ///< minimum value in the searched array, which becomes the peak if the array is inverted
+    bool           haveSearchPeak; ///< have searchPeak and searchMin been set?
     float          xCentroid;      ///< x-pixel location of centroid
     float          yCentroid;      ///< y-pixel location of centroid
     float          zCentroid;      ///< z-pixel location of centroid
@@ -352,6 +362,9 @@ namespace duchamp
   /// @brief Add an object into a list, combining with adjacent objects if need be. 
   void mergeIntoList(Detection &object, std::vector <Detection> &objList, 
 		     Param &par);
+  /// @brief Add an object into a list, using a DetectionGrid to find the objects it might combine with.
+  void mergeIntoList(Detection &object, std::vector <Detection> &objList, 
+		     Param &par, DetectionGrid &grid);
 
   //----------------
   // These are in Cubes/Merger.cc
@@ -0,0 +1,136 @@
+// -----------------------------------------------------------------------
+// findRuns.cc: Find the runs of detected pixels in the rows of an
+//              image.
+// -----------------------------------------------------------------------
+// Copyright (C) 2006, Matthew Whiting, ATNF
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or (at your
+// option) any later version.
+//
+// Duchamp is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Duchamp; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA
+//
+// Correspondence concerning Duchamp may be directed to:
+//    Internet email: Matthew.Whiting [at] atnf.csiro.au
+//    Postal address: Dr. Matthew Whiting
+//                    Australia Telescope National Facility, CSIRO
+//                    PO Box 76
+//                    Epping NSW 1710
+//                    AUSTRALIA
+// -----------------------------------------------------------------------
+#include <vector>
+#include <string.h>
+#include <duchamp/param.hh>
+#include <duchamp/Detection/finders.hh>
+#include <duchamp/PixelMap/Scan.hh>
+#include <duchamp/Utils/Statistics.hh>
+
+using namespace PixelInfo;
+
+namespace duchamp
+{
+
+  void thresholdRow(float *row, size_t xdim, Param &par, Statistics::StatsContainer<float> &stats, unsigned char *mask)
+  {
+    /// @details
+    ///  Sets mask[x] to 1 for each pixel of a row that is not BLANK
+    ///  and is a detection according to the statistics, and to 0
+    ///  otherwise -- the same test as Image::isDetection(). For a
+    ///  simple flux threshold, the threshold and BLANK keywords are
+    ///  read once, and the loops over the row have no branches, so
+    ///  that the compiler can vectorise them. With FDR, each pixel is
+    ///  tested with StatsContainer::isDetection().
+    ///  \param row The array of values.
+    ///  \param xdim The number of values.
+    ///  \param par The parameters, giving the BLANK pixel definition.
+    ///  \param stats The statistics, giving the threshold.
+    ///  \param mask The output array, of size xdim.
+
+    if(stats.getUseFDR()){
+      for(size_t x=0;x<xdim;x++)
+	mask[x] = (!par.isBlank(row[x]) && stats.isDetection(row[x])) ? 1 : 0;
+    }
+    else{
+      float threshold = stats.getThreshold();
+      for(size_t x=0;x<xdim;x++) mask[x] = (row[x] > threshold);
+      if(par.getFlagBlankPix()){
+	// The same test as Param::isBlank()
+	int blank = par.getBlankKeyword();
+	float bzero = par.getBzeroKeyword();
+	float bscale = par.getBscaleKeyword();
+	for(size_t x=0;x<xdim;x++) mask[x] &= (int((row[x]-bzero)/bscale) != blank);
+      }
+    }
+  }
+  //--------------------------------------------------------------------
+
+  void maskToRuns(unsigned char *mask, size_t xdim, long y, std::vector<Scan> &runs)
+  {
+    /// @details
+    ///  Adds a Scan to the list for each run of consecutive pixels
+    ///  that are set in a row of a mask made by thresholdRow(). The
+    ///  mask is read a word at a time wherever it is all clear or all
+    ///  set, so long stretches of background or of detected pixels
+    ///  are passed over quickly.
+    ///  \param mask The mask, with values of 0 or 1.
+    ///  \param xdim The length of the row.
+    ///  \param y The row number given to the Scans.
+    ///  \param runs The list the Scans are added to.
+
+    const size_t wordSize = sizeof(size_t);
+    const size_t allSet = size_t(-1)/255;  // a 1 in every byte
+    size_t word;
+    size_t x=0;
+    while(x<xdim){
+      while(x+wordSize<=xdim){
+	memcpy(&word,mask+x,wordSize);
+	if(word!=0) break;
+	x += wordSize;
+      }
+      while(x<xdim && !mask[x]) x++;
+      if(x==xdim) break;
+
+      size_t start=x;
+      while(x+wordSize<=xdim){
+	memcpy(&word,mask+x,wordSize);
+	if(word!=allSet) break;
+	x += wordSize;
+      }
+      while(x<xdim && mask[x]) x++;
+      runs.push_back(Scan(y,start,x-start));
+    }
+  }
+  //--------------------------------------------------------------------
+
+  std::vector<Scan> findRuns(float *array, size_t xdim, size_t ydim, Param &par, Statistics::StatsContainer<float> &stats)
+  {
+    /// @details
+    ///  Finds the runs of detected pixels in each row of an image,
+    ///  with thresholdRow() and maskToRuns(), ready for the run-based
+    ///  lutz_detect().
+    ///  \param array The image, of size xdim*ydim.
+    ///  \param xdim The x-dimension of the image.
+    ///  \param ydim The y-dimension of the image.
+    ///  \param par The parameters, giving the BLANK pixel definition.
+    ///  \param stats The statistics, giving the threshold.
+    ///  \return The runs, in order of row and then x.
+
+    std::vector<Scan> runs;
+    if(xdim==0) return runs;
+    std::vector<unsigned char> mask(xdim);
+    for(size_t y=0;y<ydim;y++){
+      thresholdRow(array+y*xdim, xdim, par, stats, &mask[0]);
+      maskToRuns(&mask[0], xdim, y, runs);
+    }
+    return runs;
+  }
+
+}
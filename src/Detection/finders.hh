@@ -27,6 +27,8 @@
 // -----------------------------------------------------------------------
 #include <duchamp/PixelMap/Object2D.hh>
 #include <duchamp/PixelMap/Scan.hh>
+#include <duchamp/param.hh>
+#include <duchamp/Utils/Statistics.hh>
 #include <vector>
 
 namespace duchamp 
@@ -35,6 +37,22 @@ namespace duchamp
   /// @brief The main 2D source-detection function
   std::vector<PixelInfo::Object2D> lutz_detect(std::vector<bool> &array, size_t xdim, size_t ydim, unsigned int minSize);
 
+  /// @brief The 2D source-detection function, working from runs of detected pixels
+  std::vector<PixelInfo::Object2D> lutz_detect(std::vector<PixelInfo::Scan> &runs, unsigned int minSize);
+
+  /// @brief The 2D source-detection function, splitting the image into strips that are searched in parallel
+  std::vector<PixelInfo::Object2D> stripDetect(float *array, size_t xdim, size_t ydim, unsigned int minSize,
+					       Param &par, Statistics::StatsContainer<float> &stats);
+
+  /// @brief Mark the detected pixels of a row of values
+  void thresholdRow(float *row, size_t xdim, Param &par, Statistics::StatsContainer<float> &stats, unsigned char *mask);
+
+  /// @brief Find the runs of marked pixels in a row of a mask
+  void maskToRuns(unsigned char *mask, size_t xdim, long y, std::vector<PixelInfo::Scan> &runs);
+
+  /// @brief Find the runs of detected pixels in each row of a 2D array
+  std::vector<PixelInfo::Scan> findRuns(float *array, size_t xdim, size_t ydim, Param &par, Statistics::StatsContainer<float> &stats);
+
   /// @brief A source detection function that operates on a 1D spectrum
   std::vector<PixelInfo::Scan> spectrumDetect(std::vector<bool> &array, size_t dim, unsigned int minSize);
 
@@ -26,9 +26,11 @@
 //                    AUSTRALIA
 // -----------------------------------------------------------------------
 #include <duchamp/Detection/finders.hh>
+#include <duchamp/Detection/UnionFind.hh>
 #include <duchamp/PixelMap/Voxel.hh>
 #include <duchamp/PixelMap/Object2D.hh>
 #include <vector>
+#include <algorithm>
 
 using namespace PixelInfo;
 
@@ -67,6 +69,97 @@ public:
 };
 //---------------------------
 
+/// @brief Join each run of a row to the runs of the row before that it touches.
+static void joinRunRows(std::vector<Scan> &runs, duchamp::UnionFind &objects,
+			size_t prevStart, size_t prevEnd, size_t start, size_t end)
+{
+  if(prevStart==prevEnd || start==end) return;
+  if(runs[start].getY() != runs[prevStart].getY()+1) return;
+  size_t prior = prevStart;
+  for(size_t run=start;run<end;run++){
+    while(prior<prevEnd && runs[prior].getXmax()+1<runs[run].getX()) prior++;
+    for(size_t other=prior; other<prevEnd && runs[other].getX()<=runs[run].getXmax()+1; other++)
+      objects.join(other,run);
+  }
+}
+
+/// @brief Join the runs of a set of rows to those in neighbouring rows.
+static void joinRunsInRows(std::vector<Scan> &runs, duchamp::UnionFind &objects, size_t first, size_t last)
+{
+  size_t prevStart=first, start=first;
+  while(start<last){
+    size_t end=start;
+    while(end<last && runs[end].getY()==runs[start].getY()) end++;
+    joinRunRows(runs,objects,prevStart,start,start,end);
+    prevStart = start;
+    start = end;
+  }
+}
+
+/// @brief Make the list of objects from a set of joined runs.
+static std::vector<Object2D> collectObjects(std::vector<Scan> &runs, duchamp::UnionFind &objects,
+					    unsigned int minSize, int numThreads)
+{
+  /// Objects are listed in the order in which the pixel-based
+  /// lutz_detect() would complete them: after the last row that has
+  /// one of their runs, and for those completed together, in order
+  /// of their last run on that row. Only those with at least minSize
+  /// pixels are kept.
+
+  size_t numRuns = runs.size();
+  std::vector<size_t> continued(numRuns,numRuns+1), seen(numRuns,numRuns+1);
+  std::vector<size_t> completed;  // the root of each completed object
+  size_t prevStart=0, prevEnd=0;
+  size_t start=0;
+  while(true){
+    // The final pass, with start==numRuns, completes the remaining objects.
+    size_t end=start;
+    while(end<numRuns && runs[end].getY()==runs[start].getY()) end++;
+    bool adjacent = (start<numRuns && prevEnd>prevStart && runs[start].getY()==runs[prevStart].getY()+1);
+    if(adjacent)
+      for(size_t run=start;run<end;run++) continued[objects.findRoot(run)] = start;
+    size_t numDone = completed.size();
+    for(size_t run=prevEnd; run>prevStart; run--){
+      size_t root = objects.findRoot(run-1);
+      if(continued[root]!=start && seen[root]!=start){
+	seen[root] = start;
+	completed.push_back(root);
+      }
+    }
+    std::reverse(completed.begin()+numDone, completed.end());
+    if(start==numRuns) break;
+    prevStart = start;
+    prevEnd = end;
+    start = end;
+  }
+
+  // Number the objects that are big enough, and sort the runs by
+  // object, keeping them in order within each.
+  std::vector<size_t> size(numRuns,0);
+  for(size_t run=0;run<numRuns;run++) size[objects.findRoot(run)] += runs[run].getXlen();
+  std::vector<size_t> label(numRuns,numRuns);
+  size_t numObjects=0;
+  for(size_t i=0;i<completed.size();i++)
+    if(size[completed[i]]>=minSize) label[completed[i]] = numObjects++;
+  std::vector<size_t> first(numObjects+1,0), order(numRuns);
+  for(size_t run=0;run<numRuns;run++){
+    label[run] = label[objects.findRoot(run)];
+    if(label[run]<numObjects) first[label[run]+1]++;
+  }
+  for(size_t obj=0;obj<numObjects;obj++) first[obj+1] += first[obj];
+  std::vector<size_t> next(first.begin(),first.end()-1);
+  for(size_t run=0;run<numRuns;run++)
+    if(label[run]<numObjects) order[next[label[run]]++] = run;
+
+  std::vector<Object2D> outputlist(numObjects);
+#pragma omp parallel for num_threads(numThreads) schedule(dynamic,64)
+  for(long obj=0;obj<long(numObjects);obj++)
+    for(size_t i=first[obj];i<first[obj+1];i++) outputlist[obj].appendScan(runs[order[i]]);
+
+  return outputlist;
+}
+//---------------------------
+
 namespace duchamp
 {
 
@@ -272,4 +365,114 @@ namespace duchamp
 
   }
 
+  //--------------------------------------------------------------------
+
+  std::vector<Object2D> lutz_detect(std::vector<Scan> &runs, unsigned int minSize) 
+  {
+    /// @details
+    ///  A version of lutz_detect() that works from the runs of
+    ///  detected pixels in each row, as found by findRuns(), rather
+    ///  than from the individual pixels.
+    ///
+    ///  Each run is joined to the runs of the previous row that it
+    ///  touches (in an 8-fold sense), using a union-find structure,
+    ///  so the work done depends on the number of runs rather than
+    ///  the number of pixels. An object is complete once none of the
+    ///  runs of a row touches it. The objects are listed in the order
+    ///  in which they are completed, and those completed on the same
+    ///  row in order of their last run on the row before, which is
+    ///  the order in which the pixel-based lutz_detect() finds them,
+    ///  so both give the same list of objects for the same image.
+    ///  \param runs The runs of detected pixels, in order of row and then x.
+    ///  \param minSize The minimum number of pixels in an object.
+    ///  \return The list of objects.
+
+    UnionFind objects(runs.size());
+    joinRunsInRows(runs,objects,0,runs.size());
+    return collectObjects(runs,objects,minSize,1);
+  }
+  //--------------------------------------------------------------------
+
+  std::vector<Object2D> stripDetect(float *array, size_t xdim, size_t ydim, unsigned int minSize,
+				    Param &par, Statistics::StatsContainer<float> &stats)
+  {
+    /// @details
+    ///  Finds the objects in a 2D image using Param::numThreads
+    ///  threads, giving exactly the same list as findRuns() followed
+    ///  by the run-based lutz_detect().
+    ///
+    ///  The image is split into horizontal strips, one per thread.
+    ///  The runs of each strip are found, and joined to each other,
+    ///  independently. The runs of the first row of each strip are
+    ///  then joined to those of the last row of the strip before. As
+    ///  the root of each object is always its earliest run, the
+    ///  result does not depend on the order of the joins, and the
+    ///  objects are then collected in the same way as for a single
+    ///  strip. Small images are not split up.
+    ///  \param array The image, of size xdim*ydim.
+    ///  \param xdim The x-dimension of the image.
+    ///  \param ydim The y-dimension of the image.
+    ///  \param minSize The minimum number of pixels in an object.
+    ///  \param par The parameters, giving the number of threads and
+    ///  the BLANK pixel definition.
+    ///  \param stats The statistics, giving the threshold.
+    ///  \return The list of objects.
+
+    const size_t minStripSize = 262144;  // the smallest strip, in pixels, worth a thread
+    size_t numStrips = std::min(size_t(par.getNumThreads()), ydim);
+    if(xdim>0) numStrips = std::min(numStrips, xdim*ydim/minStripSize);
+    if(numStrips<2){
+      std::vector<Scan> runs = findRuns(array,xdim,ydim,par,stats);
+      return lutz_detect(runs,minSize);
+    }
+
+    std::vector< std::vector<Scan> > stripRuns(numStrips);
+    std::vector<size_t> stripStart(numStrips+1,0);
+    std::vector<Scan> runs;
+    UnionFind objects;
+
+#pragma omp parallel num_threads(numStrips)
+    {
+#pragma omp for schedule(static)
+      for(long strip=0; strip<long(numStrips); strip++){
+	size_t firstRow = ydim*strip/numStrips, lastRow = ydim*(strip+1)/numStrips;
+	std::vector<unsigned char> mask(xdim);
+	for(size_t y=firstRow;y<lastRow;y++){
+	  thresholdRow(array+y*xdim, xdim, par, stats, &mask[0]);
+	  maskToRuns(&mask[0], xdim, y, stripRuns[strip]);
+	}
+      }
+
+#pragma omp single
+      {
+	for(size_t strip=0;strip<numStrips;strip++)
+	  stripStart[strip+1] = stripStart[strip] + stripRuns[strip].size();
+	runs.resize(stripStart[numStrips]);
+	objects.resize(stripStart[numStrips]);
+      }
+
+      // Each strip's runs are only joined to each other here, so the
+      // threads use separate parts of the union-find structure.
+#pragma omp for schedule(static)
+      for(long strip=0; strip<long(numStrips); strip++){
+	std::copy(stripRuns[strip].begin(), stripRuns[strip].end(), runs.begin()+stripStart[strip]);
+	std::vector<Scan>().swap(stripRuns[strip]);
+	joinRunsInRows(runs,objects,stripStart[strip],stripStart[strip+1]);
+      }
+    }
+
+    // Join the objects across the boundaries between the strips.
+    for(size_t strip=1;strip<numStrips;strip++){
+      size_t boundary = stripStart[strip];
+      if(boundary==0 || boundary==runs.size() || boundary==stripStart[strip-1]) continue;
+      size_t prevStart = boundary-1;
+      while(prevStart>0 && runs[prevStart-1].getY()==runs[boundary-1].getY()) prevStart--;
+      size_t end = boundary;
+      while(end<runs.size() && runs[end].getY()==runs[boundary].getY()) end++;
+      joinRunRows(runs,objects,prevStart,boundary,boundary,end);
+    }
+
+    return collectObjects(runs,objects,minSize,numStrips);
+  }
+
 }
@@ -29,6 +29,7 @@
 #include <vector>
 #include <duchamp/Cubes/cubes.hh>
 #include <duchamp/Utils/utils.hh>
+#include <duchamp/Detection/DetectionGrid.hh>
 
 namespace duchamp
 {
@@ -62,4 +63,38 @@ namespace duchamp
 
   }
 
+  void mergeIntoList(Detection &object, std::vector <Detection> &objList, Param &par, DetectionGrid &grid)
+  {
+    /// @details
+    /// As for the function above, but rather than testing every
+    /// member of the list, only those that the DetectionGrid finds
+    /// near the object are tested. The object is merged into the
+    /// first of these that it can be combined with, which is the
+    /// first in the whole list, so the result is the same. The grid
+    /// is updated with the Detection that has grown (or been added),
+    /// so it needs to have been given every member of the list --
+    /// typically it starts out empty, along with the list.
+    /// 
+    /// \param object The Detection to be merged into the list.
+    /// \param objList The vector list of Detections.
+    /// \param par The Param set, used for testing if merging needs to be done.
+    /// \param grid The DetectionGrid indexing the list.
+
+    std::vector<size_t> candidates;
+    grid.findCandidates(object, candidates);
+
+    for(size_t i=0;i<candidates.size();i++){
+      size_t id = candidates[i];
+      if(objList[id].canMerge(object,par)){
+	objList[id].addDetection(object);
+	grid.add(id, objList[id]);
+	return;
+      }
+    }
+
+    objList.push_back(object);
+    grid.add(objList.size()-1, objList.back());
+
+  }
+
 }
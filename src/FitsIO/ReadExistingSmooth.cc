@@ -89,7 +89,8 @@ namespace duchamp {
       int status = 0;
       char *comment = new char[80];
 
-      if(this->itsCube->pars().getSmoothType()=="spectral"){
+      std::string smoothType = this->itsCube->pars().getSmoothType();
+      if(smoothType=="spectral" || smoothType=="3D"){
 
 	int hannWidth;
 	fits_read_key(this->itsFptr, TINT, (char *)keyword_hanningwidth.c_str(), 
@@ -100,7 +101,18 @@ namespace duchamp {
 	}
 
       }
-      else if(this->itsCube->pars().getSmoothType()=="spatial"){
+      if(smoothType=="recursive"){
+
+	float fwhm;
+	fits_read_key(this->itsFptr, TFLOAT, (char *)keyword_spectralfwhm.c_str(), 
+		      &fwhm, comment, &status);
+	if(fwhm != this->itsCube->pars().getSpectralFWHM()){
+	  DUCHAMPERROR("readSmoothCube", keyword_spectralfwhm << " keyword in smoothFile (" << fwhm << ") does not match the spectralFWHM parameter (" << this->itsCube->pars().getSpectralFWHM() << ").");
+	  result = FAILURE;
+	}
+
+      }
+      if(smoothType=="spatial" || smoothType=="3D"){
 
 	float maj,min,pa;
 	status = 0;
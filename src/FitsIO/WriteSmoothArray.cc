@@ -80,7 +80,8 @@ namespace duchamp {
       }
     }
     
-    if(this->itsCube->pars().getSmoothType()=="spatial"){
+    std::string smoothType = this->itsCube->pars().getSmoothType();
+    if(smoothType=="spatial" || smoothType=="3D"){
       // if kernMin is negative (not defined), make it equal to kernMaj
       float kernMaj=this->itsCube->pars().getKernMaj();
       float kernMin=this->itsCube->pars().getKernMin();
@@ -89,7 +90,7 @@ namespace duchamp {
 
       status=0;
       if(fits_write_key(this->itsFptr, TSTRING, (char *)keyword_smoothtype.c_str(),
-			(char *)header_smoothSpatial.c_str(),
+			(char *)(smoothType=="3D" ? header_smooth3D : header_smoothSpatial).c_str(),
 			(char *)comment_smoothtype.c_str(), &status)){
 	duchampFITSerror(status,"writeSmoothArray","Error : header I/O");
 	result=FAILURE;
@@ -112,8 +113,17 @@ namespace duchamp {
 	duchampFITSerror(status,"writeSmoothArray","Error : header I/O");
 	result=FAILURE;
       }
+      if(smoothType=="3D"){
+	int width = this->itsCube->pars().getHanningWidth();
+	status=0;
+	if(fits_write_key(this->itsFptr, TINT, (char *)keyword_hanningwidth.c_str(), &width,
+			  (char *)comment_hanningwidth.c_str(), &status)){
+	  duchampFITSerror(status,"writeSmoothArray","Error : header I/O");
+	  result=FAILURE;
+	}
+      }
     }
-    else if(this->itsCube->pars().getSmoothType()=="spectral"){
+    else if(smoothType=="spectral"){
       status=0;
       if(fits_write_key(this->itsFptr, TSTRING, (char *)keyword_smoothtype.c_str(),
 			(char *)header_smoothSpectral.c_str(),
@@ -130,6 +140,23 @@ namespace duchamp {
       }
     }
 
+    else if(smoothType=="recursive"){
+      status=0;
+      if(fits_write_key(this->itsFptr, TSTRING, (char *)keyword_smoothtype.c_str(),
+			(char *)header_smoothRecursive.c_str(),
+			(char *)comment_smoothtype.c_str(), &status)){
+	duchampFITSerror(status,"writeSmoothArray","Error : header I/O");
+	result=FAILURE;
+      }
+      float fwhm = this->itsCube->pars().getSpectralFWHM();
+      status=0;
+      if(fits_write_key(this->itsFptr, TFLOAT, (char *)keyword_spectralfwhm.c_str(), &fwhm,
+			(char *)comment_spectralfwhm.c_str(), &status)){
+	duchampFITSerror(status,"writeSmoothArray","Error : header I/O");
+	result=FAILURE;
+      }
+    }
+
     return result;
 
   }
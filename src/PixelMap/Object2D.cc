@@ -174,6 +174,36 @@ namespace PixelInfo
   }
   //------------------------------------------------------
 
+  void Object2D::appendScan(Scan &scan)
+  {
+    ///  Adds a Scan to the end of the Scan list, without the checks
+    ///  done by addScan(). The Scan must not overlap or touch any
+    ///  Scan already in the Object, as is the case when the Object
+    ///  is being built from the separate runs of pixels found in a
+    ///  raster scan. The sums, mins and maxs are updated a pixel at a
+    ///  time, in the same way as addPixel() does.
+
+    long y=scan.getY();
+    for(long x=scan.getX();x<=scan.getXmax();x++){
+      if(this->numPix==0){
+	this->xSum = this->xmin = this->xmax = x;
+	this->ySum = this->ymin = this->ymax = y;
+      }
+      else{
+	this->xSum += x;
+	this->ySum += y;
+	if(x<this->xmin) this->xmin = x;
+	if(x>this->xmax) this->xmax = x;
+	if(y<this->ymin) this->ymin = y;
+	if(y>this->ymax) this->ymax = y;
+      }
+      this->numPix++;
+    }
+    this->scanlist.push_back(scan);
+
+  }
+  //------------------------------------------------------
+
   bool Object2D::isInObject(long x, long y)
   {
 
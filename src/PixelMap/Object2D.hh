@@ -71,6 +71,9 @@ namespace PixelInfo
     /// @brief Add a full Scan to the Object, making sure there are no overlapping scans afterwards. 
     void  addScan(Scan &scan);
 
+    /// @brief Add a Scan that is known not to overlap or touch any in the Object, without checking. 
+    void  appendScan(Scan &scan);
+
     /// @brief Test whether a pixel (x,y) is in the Object. 
     bool  isInObject(long x, long y);
     /// @brief Test whether the (x,y) part of a Voxel is in the Object.
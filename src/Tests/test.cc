@@ -1,2 +1,97 @@
 #define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
 #include "catch.hpp"
+
+#include <math.h>
+#include <vector>
+#include <string>
+#include <duchamp/duchamp.hh>
+#include <duchamp/param.hh>
+#include <duchamp/Cubes/cubes.hh>
+#include <duchamp/Detection/detection.hh>
+
+using namespace duchamp;
+
+/// @brief Make a test cube of Gaussian noise, with a positive and a negative source.
+std::vector<float> makeSmoothingTestCube(size_t *dim)
+{
+  std::vector<float> data(dim[0]*dim[1]*dim[2]);
+  unsigned long seed = 12345;
+  for(size_t i=0;i<data.size();i+=2){
+    // Box-Muller, from a simple linear congruential generator
+    float u1,u2;
+    seed = (seed*1103515245UL + 12345UL) % 2147483648UL;
+    u1 = (seed+1.)/2147483649.;
+    seed = (seed*1103515245UL + 12345UL) % 2147483648UL;
+    u2 = seed/2147483648.;
+    data[i] = sqrt(-2.*log(u1)) * cos(2.*M_PI*u2);
+    if(i+1<data.size()) data[i+1] = sqrt(-2.*log(u1)) * sin(2.*M_PI*u2);
+  }
+  const float source[2][4] = { {12., 12., 10., 4.}, {32., 30., 20., -4.} };  // x, y, z, amplitude
+  for(int s=0;s<2;s++){
+    for(size_t z=0;z<dim[2];z++){
+      for(size_t y=0;y<dim[1];y++){
+	for(size_t x=0;x<dim[0];x++){
+	  float r2 = pow(x-source[s][0],2) + pow(y-source[s][1],2) + 0.25*pow(z-source[s][2],2);
+	  data[x+dim[0]*(y+dim[1]*z)] += source[s][3] * exp(-0.5*r2/4.);
+	}
+      }
+    }
+  }
+  return data;
+}
+
+/// @brief Run a smoothed search on the test cube, in the same order as mainDuchamp.
+/// @details When invertArraysLast is set, the arrays of a negative
+/// search are inverted back only after the object parameters are
+/// found, as mainDuchamp does when baselines are removed.
+std::vector<Detection> runSmoothedSearch(std::string smoothType, bool negative, bool invertArraysLast, bool stream)
+{
+  size_t dim[3] = {48, 48, 32};
+  std::vector<float> data = makeSmoothingTestCube(dim);
+
+  Cube cube;
+  cube.pars().setVerbosity(false);
+  cube.pars().setFlagLog(false);
+  cube.pars().setFlagSmooth(true);
+  cube.pars().setSmoothType(smoothType);
+  cube.pars().setSearchType(smoothType=="spectral" ? "spectral" : "spatial");
+  cube.pars().setHanningWidth(5);
+  cube.pars().setKernMaj(3.);
+  cube.pars().setKernMin(3.);
+  cube.pars().setKernPA(0.);
+  cube.pars().setCut(4.);
+  cube.pars().setFlagNegative(negative);
+  // A tiny memory limit makes the search smooth the cube a window at a time.
+  cube.pars().setSmoothMemory(stream ? 0.001 : 0.);
+  cube.initialiseCube(dim);
+  cube.saveArray(&data[0], data.size());
+
+  if(negative) cube.invert();
+  cube.Search();
+  if(cube.getNumObj()>0) cube.ObjectMerger();
+  if(negative) cube.invert(!invertArraysLast,true);
+  if(cube.getNumObj()>0) cube.calcObjectWCSparams();
+  if(negative && invertArraysLast) cube.invert(true,true);
+  return cube.getObjectList();
+}
+
+TEST_CASE("Streamed smoothed search matches the whole-cube search", "[smoothing]")
+{
+  const std::string smoothType[2] = {"spatial", "spectral"};
+  for(int t=0;t<2;t++){
+    for(int mode=0;mode<3;mode++){
+      bool negative = (mode>0), invertArraysLast = (mode==2);
+      INFO("smoothType=" << smoothType[t] << " negative=" << negative << " invertArraysLast=" << invertArraysLast);
+      std::vector<Detection> whole = runSmoothedSearch(smoothType[t], negative, invertArraysLast, false);
+      std::vector<Detection> streamed = runSmoothedSearch(smoothType[t], negative, invertArraysLast, true);
+      REQUIRE(whole.size() > 0);
+      REQUIRE(streamed.size() == whole.size());
+      for(size_t i=0;i<whole.size();i++){
+	CHECK(streamed[i].getSize() == whole[i].getSize());
+	CHECK(streamed[i].getXmin() == whole[i].getXmin());
+	CHECK(streamed[i].getZmin() == whole[i].getZmin());
+	CHECK(streamed[i].getPeakSNR() == Approx(whole[i].getPeakSNR()).epsilon(1.e-4));
+      }
+    }
+  }
+}
@@ -0,0 +1,192 @@
+// -----------------------------------------------------------------------
+// FFT.cc: Functions for the simple fast Fourier transform.
+// -----------------------------------------------------------------------
+// Copyright (C) 2006, Matthew Whiting, ATNF
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or (at your
+// option) any later version.
+//
+// Duchamp is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Duchamp; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA
+//
+// Correspondence concerning Duchamp may be directed to:
+//    Internet email: Matthew.Whiting [at] atnf.csiro.au
+//    Postal address: Dr. Matthew Whiting
+//                    Australia Telescope National Facility, CSIRO
+//                    PO Box 76
+//                    Epping NSW 1710
+//                    AUSTRALIA
+// -----------------------------------------------------------------------
+// -----------------------------------------------------------------------
+#include <vector>
+#include <complex>
+#include <algorithm>
+#include <math.h>
+#include <duchamp/Utils/FFT.hh>
+
+namespace FFT
+{
+
+  size_t goodLength(size_t n)
+  {
+    /// @details
+    /// The smallest number of the form 2^a 3^b 5^c that is at least
+    /// n. These are much more closely spaced than the powers of two,
+    /// so arrays need much less padding.
+
+    size_t best=1;
+    while(best<n) best *= 2;
+    for(size_t p5=1; p5<best; p5*=5){
+      for(size_t p35=p5; p35<best; p35*=3){
+	size_t len=p35;
+	while(len<n) len *= 2;
+	best = std::min(best,len);
+      }
+    }
+    return best;
+  }
+  //--------------------------------------------------------------------
+
+  Plan::Plan(size_t length)
+  {
+    /// @details
+    /// \param length The length of the transforms. This should have
+    /// no prime factors other than 2, 3 and 5: if it does, the next
+    /// such length is used (see goodLength()).
+
+    this->len = goodLength(length);
+    size_t n = this->len;
+    const size_t radices[3] = {5,3,2};
+    for(int r=0;r<3;r++){
+      while(n % radices[r] == 0){
+	this->factors.push_back(radices[r]);
+	n /= radices[r];
+      }
+    }
+    this->twiddle.resize(this->len);
+    for(size_t k=0;k<this->len;k++){
+      double angle = -2.*M_PI*double(k)/double(this->len);
+      this->twiddle[k] = std::complex<double>(cos(angle),sin(angle));
+    }
+  }
+  //--------------------------------------------------------------------
+
+  void Plan::transform(std::complex<double> *data, size_t stride, bool inverse) const
+  {
+    /// @details
+    /// The values are copied to a contiguous buffer, transformed, and
+    /// copied back.
+    /// \param data The values to be transformed, which are replaced by the result.
+    /// \param stride The spacing in the array of the values to be transformed.
+    /// \param inverse Whether to do the inverse transform.
+
+    std::vector<std::complex<double> > buffer(2*this->len);
+    for(size_t i=0;i<this->len;i++) buffer[i] = data[i*stride];
+    this->transform(&buffer[0],&buffer[this->len],inverse);
+    for(size_t i=0;i<this->len;i++) data[i*stride] = buffer[i];
+  }
+  //--------------------------------------------------------------------
+
+  void Plan::transform(std::complex<double> *data, std::complex<double> *work, bool inverse) const
+  {
+    /// @details
+    /// A Stockham (self-sorting) transform, with a stage for each
+    /// factor of the length. Each stage reads from one of data and
+    /// work and writes to the other, so no reordering is needed at
+    /// the end. The forward transform uses exp(-2 pi i j k / n); the
+    /// inverse uses the conjugate and divides by n, so an inverse
+    /// transform undoes a forward one.
+    /// \param data The values to be transformed, which are replaced by the result.
+    /// \param work Space for len values, which are overwritten.
+    /// \param inverse Whether to do the inverse transform.
+
+    std::complex<double> *in = data, *out = work;
+    size_t n = this->len;  // the length of the sub-transforms at this stage
+    size_t s = 1;          // the number of interleaved sub-transforms
+    std::complex<double> a[5],root[5];
+
+    for(size_t f=0;f<this->factors.size();f++){
+      size_t radix = this->factors[f];
+      size_t m = n/radix;
+      if(radix==2){
+	for(size_t p=0;p<m;p++){
+	  std::complex<double> w = this->twiddle[p*s];
+	  if(inverse) w = std::conj(w);
+	  const std::complex<double> *in0 = in + s*p, *in1 = in + s*(p+m);
+	  std::complex<double> *out0 = out + s*2*p, *out1 = out + s*(2*p+1);
+	  for(size_t q=0;q<s;q++){
+	    out0[q] = in0[q] + in1[q];
+	    out1[q] = (in0[q] - in1[q]) * w;
+	  }
+	}
+      }
+      else{
+	for(size_t k=0;k<radix;k++){
+	  root[k] = this->twiddle[k*(this->len/radix)];
+	  if(inverse) root[k] = std::conj(root[k]);
+	}
+	for(size_t p=0;p<m;p++){
+	  for(size_t q=0;q<s;q++){
+	    for(size_t k=0;k<radix;k++) a[k] = in[q + s*(p+k*m)];
+	    for(size_t j=0;j<radix;j++){
+	      std::complex<double> sum = a[0];
+	      for(size_t k=1;k<radix;k++) sum += a[k]*root[(j*k)%radix];
+	      std::complex<double> w = this->twiddle[p*j*s];
+	      if(inverse) w = std::conj(w);
+	      out[q + s*(radix*p+j)] = sum*w;
+	    }
+	  }
+	}
+      }
+      std::swap(in,out);
+      n = m;
+      s *= radix;
+    }
+
+    if(in!=data) std::copy(in,in+this->len,data);
+
+    if(inverse){
+      double scale = 1./double(this->len);
+      for(size_t i=0;i<this->len;i++) data[i] *= scale;
+    }
+  }
+  //--------------------------------------------------------------------
+
+  void transform2D(std::complex<double> *data, const Plan &xplan, const Plan &yplan, bool inverse)
+  {
+    /// @details
+    /// The rows are transformed in place. The columns are copied, a
+    /// few at a time, to a contiguous buffer to be transformed, as
+    /// working on the widely-spaced values of a column directly would
+    /// make poor use of the cache.
+    /// \param data The array, with x varying fastest, which is replaced by its transform.
+    /// \param xplan The Plan for the rows: its length is the x-dimension of the array.
+    /// \param yplan The Plan for the columns: its length is the y-dimension of the array.
+    /// \param inverse Whether to do the inverse transform.
+
+    size_t nx = xplan.length();
+    size_t ny = yplan.length();
+    std::vector<std::complex<double> > work(std::max(nx,ny));
+    for(size_t y=0;y<ny;y++) xplan.transform(data+y*nx,&work[0],inverse);
+
+    const size_t blockSize = 16;
+    std::vector<std::complex<double> > columns(blockSize*ny);
+    for(size_t x0=0;x0<nx;x0+=blockSize){
+      size_t numCols = std::min(blockSize,nx-x0);
+      for(size_t y=0;y<ny;y++)
+	for(size_t c=0;c<numCols;c++) columns[c*ny+y] = data[y*nx+x0+c];
+      for(size_t c=0;c<numCols;c++) yplan.transform(&columns[c*ny],&work[0],inverse);
+      for(size_t y=0;y<ny;y++)
+	for(size_t c=0;c<numCols;c++) data[y*nx+x0+c] = columns[c*ny+y];
+    }
+  }
+
+}
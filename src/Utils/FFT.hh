@@ -0,0 +1,77 @@
+// -----------------------------------------------------------------------
+// FFT.hh: A simple, self-contained fast Fourier transform, used for
+//         convolving images with large kernels.
+// -----------------------------------------------------------------------
+// Copyright (C) 2006, Matthew Whiting, ATNF
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or (at your
+// option) any later version.
+//
+// Duchamp is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Duchamp; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA
+//
+// Correspondence concerning Duchamp may be directed to:
+//    Internet email: Matthew.Whiting [at] atnf.csiro.au
+//    Postal address: Dr. Matthew Whiting
+//                    Australia Telescope National Facility, CSIRO
+//                    PO Box 76
+//                    Epping NSW 1710
+//                    AUSTRALIA
+// -----------------------------------------------------------------------
+// -----------------------------------------------------------------------
+#ifndef DUCHAMP_FFT_H
+#define DUCHAMP_FFT_H
+
+#include <vector>
+#include <complex>
+#include <stddef.h>
+
+namespace FFT
+{
+
+  /// @brief The smallest length that can be transformed that is at least n.
+  size_t goodLength(size_t n);
+
+  /// @brief
+  ///  A one-dimensional complex FFT of a fixed length.
+  /// @details
+  ///  This is a mixed-radix transform, so the length must have no
+  ///  prime factors other than 2, 3 and 5 (see goodLength()). The
+  ///  factors and the twiddle factors are worked out when the Plan is
+  ///  created, so a Plan should be reused for all transforms of the
+  ///  same length. A Plan is not changed by transform(), so can be
+  ///  shared between threads.
+
+  class Plan
+  {
+  public:
+    Plan(size_t length);
+    virtual ~Plan(){};
+
+    size_t length() const {return len;};
+
+    /// @brief Transform length values, spaced by stride, in place.
+    void transform(std::complex<double> *data, size_t stride=1, bool inverse=false) const;
+    /// @brief Transform length contiguous values in place, using work (of at least length values) as scratch space.
+    void transform(std::complex<double> *data, std::complex<double> *work, bool inverse) const;
+
+  private:
+    size_t len;                                 ///< The length of the transform.
+    std::vector<size_t> factors;                ///< The radix of each stage: 2, 3 or 5.
+    std::vector<std::complex<double> > twiddle; ///< exp(-2 pi i k / len), for k < len.
+  };
+
+  /// @brief Transform a 2D array in place, using the given Plans for the rows and columns.
+  void transform2D(std::complex<double> *data, const Plan &xplan, const Plan &yplan, bool inverse=false);
+
+}
+
+#endif // DUCHAMP_FFT_H
@@ -37,6 +37,7 @@
 #define MAXVAL 1.e38F
 #endif
 #include <duchamp/Utils/GaussSmooth1D.hh>
+#include <duchamp/Utils/SpectralConvolution.hh>
 
 template <class Type>
 GaussSmooth1D<Type>::GaussSmooth1D()
@@ -57,6 +58,7 @@ template GaussSmooth1D<double>::~GaussSmooth1D();
 template <class Type>
 GaussSmooth1D<Type>::GaussSmooth1D(const GaussSmooth1D& g)
 {
+  this->allocated=false;
   operator=(g);
 }
 template GaussSmooth1D<float>::GaussSmooth1D(const GaussSmooth1D& g);
@@ -72,8 +74,8 @@ GaussSmooth1D<Type>& GaussSmooth1D<Type>::operator=(const GaussSmooth1D& g)
   if(this->allocated) delete [] this->kernel;
   this->allocated = g.allocated;
   if(this->allocated){
-    this->kernel = new Type[this->kernWidth*this->kernWidth];
-    for(int i=0;i<this->kernWidth*this->kernWidth;i++)
+    this->kernel = new Type[this->kernWidth];
+    for(int i=0;i<this->kernWidth;i++)
       this->kernel[i] = g.kernel[i];
   }
   return *this;
@@ -143,14 +145,14 @@ Type *GaussSmooth1D<Type>::smooth(Type *input, int dim, bool normalise, bool sca
 
   Type *smoothed;
   std::vector<bool> mask(dim,true);
-  smoothed = this->smooth(input,dim,mask,scaleByCoverage);
+  smoothed = this->smooth(input,dim,mask,normalise,scaleByCoverage);
   return smoothed;
 }
 template float *GaussSmooth1D<float>::smooth(float *input, int dim, bool normalise, bool scaleByCoverage);
 template double *GaussSmooth1D<double>::smooth(double *input, int dim, bool normalise, bool scaleByCoverage);
 
 template <class Type>
-Type *GaussSmooth1D<Type>::smooth(Type *input, int dim, std::vector<bool> mask, bool normalise, bool scaleByCoverage)
+Type *GaussSmooth1D<Type>::smooth(Type *input, int dim, const std::vector<bool> &mask, bool normalise, bool scaleByCoverage)
 {
   /// @details Smooth a given one-dimensional array, of dimension dim,
   ///  with a gaussian, where the boolean array mask defines which
@@ -174,50 +176,45 @@ Type *GaussSmooth1D<Type>::smooth(Type *input, int dim, std::vector<bool> mask,
 
   if(!this->allocated) return input;
   else{
-
     Type *output = new Type[dim];
-
-    int comp,fpos,ct;
-    float fsum,kernsum=0;
-    int kernelHW = this->kernWidth/2;
-
-    for(int i=0;i<this->kernWidth;i++)
-      kernsum += this->kernel[i];
-    
-    for(int pos = 0; pos<dim; pos++){
-      
-      if(!mask[pos]) output[pos] = input[pos];
-      else{
-	
-	ct=0;
-	fsum=0.;
-	output[pos] = 0.;
-	
-	for(int off = -kernelHW; off<=kernelHW; off++){
-	  comp = pos + off;	      
-	  if((comp>=0)&&(comp<dim)){
-	    fpos = (off+kernelHW);
-	    if(mask[comp]){
-	      ct++;
-	      fsum += this->kernel[fpos];
-	      output[pos] += input[comp]*this->kernel[fpos];
-	    }
-
-	  }
-	} // off loop
-	
-	if(ct>0){
-	  if(scaleByCoverage) output[pos] /= fsum;
-	  if(normalise) output[pos] /= kernsum;
-	}
-
-      } // else{
-
-    } //pos loop
-   
+    this->smoothSpectra(input,output,1,dim,mask,normalise,scaleByCoverage);
     return output;
   }
   
 }
-template float *GaussSmooth1D<float>::smooth(float *input, int dim, std::vector<bool> mask, bool normalise, bool scaleByCoverage);
-template double *GaussSmooth1D<double>::smooth(double *input, int dim, std::vector<bool> mask, bool normalise, bool scaleByCoverage);
+template float *GaussSmooth1D<float>::smooth(float *input, int dim, const std::vector<bool> &mask, bool normalise, bool scaleByCoverage);
+template double *GaussSmooth1D<double>::smooth(double *input, int dim, const std::vector<bool> &mask, bool normalise, bool scaleByCoverage);
+
+template <class Type>
+void GaussSmooth1D<Type>::smoothSpectra(Type *input, Type *output, size_t xySize, size_t zdim, const std::vector<bool> &mask,
+					bool normalise, bool scaleByCoverage, int numThreads)
+{
+  /// @details Smooth each spectrum of a cube with the gaussian,
+  ///  working on whole channel maps at a time (see
+  ///  convolveSpectra()). The treatment of masked values and the
+  ///  scaling are the same as for
+  ///  GaussSmooth1D::smooth(Type *, int, vector<bool>, bool, bool). If
+  ///  no kernel has been defined, the input is copied to the output.
+  /// 
+  ///  \param input The cube to be smoothed.
+  ///  \param output Where the smoothed cube is written.
+  ///  \param xySize The number of pixels in each channel map.
+  ///  \param zdim The number of channels.
+  ///  \param mask The vector showing which values in the input are valid.
+  ///  \param normalise Whether to divide by the sum of the kernel.
+  ///  \param scaleByCoverage Whether to divide by the sum of the kernel values that covered valid values.
+  ///  \param numThreads The number of threads to use.
+
+  if(!this->allocated){
+    for(size_t i=0;i<xySize*zdim;i++) output[i] = input[i];
+  }
+  else{
+    float kernsum=0.;
+    if(normalise)
+      for(int i=0;i<this->kernWidth;i++) kernsum += this->kernel[i];
+    else kernsum = 1.;
+    convolveSpectra(input,output,xySize,zdim,mask,this->kernel,this->kernWidth,scaleByCoverage,kernsum,numThreads);
+  }
+}
+template void GaussSmooth1D<float>::smoothSpectra(float *input, float *output, size_t xySize, size_t zdim, const std::vector<bool> &mask, bool normalise, bool scaleByCoverage, int numThreads);
+template void GaussSmooth1D<double>::smoothSpectra(double *input, double *output, size_t xySize, size_t zdim, const std::vector<bool> &mask, bool normalise, bool scaleByCoverage, int numThreads);
@@ -29,6 +29,7 @@
 #ifndef GAUSSSMOOTH1D_H
 #define GAUSSSMOOTH1D_H
 #include <vector>
+#include <stddef.h>
 /// @brief
 ///  Define a Gaussian to smooth a 2D array.
 /// @details
@@ -54,7 +55,10 @@ public:
   /// @brief Smooth an array with the Gaussian kernel
   Type *smooth(Type *input, int dim, bool normalise=false, bool scaleByCoverage=false);  
   /// @brief Smooth an array with the Gaussian kernel, using a mask to define blank pixels
-  Type *smooth(Type *input, int dim, std::vector<bool> mask, bool normalise=false, bool scaleByCoverage=false);  
+  Type *smooth(Type *input, int dim, const std::vector<bool> &mask, bool normalise=false, bool scaleByCoverage=false);  
+  /// @brief Smooth every spectrum of a cube with the Gaussian kernel
+  void  smoothSpectra(Type *input, Type *output, size_t xySize, size_t zdim, const std::vector<bool> &mask,
+		      bool normalise=false, bool scaleByCoverage=false, int numThreads=1);
   
   void   setKernFWHM(float f){kernFWHM=f;};
 
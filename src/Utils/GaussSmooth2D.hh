@@ -29,7 +29,9 @@
 #ifndef GAUSSSMOOTH2D_H
 #define GAUSSSMOOTH2D_H
 #include <vector>
+#include <complex>
 #include <duchamp/duchamp.hh>
+#include <duchamp/Utils/FFT.hh>
 
 /// @brief How the edges of the array are dealt with
 enum EDGES { EQUALTOEDGE,       ///< All pixels are used and treated equally
@@ -37,6 +39,14 @@ enum EDGES { EQUALTOEDGE,       ///< All pixels are used and treated equally
 	     TRUNCATE           ///< Pixels at edge are set to Blank.
 };
 
+/// @brief How the convolution with the kernel is done
+enum SMOOTHMETHOD { SMOOTH_AUTO,       ///< Chosen from the shape of the kernel
+		    SMOOTH_DENSE,      ///< The full 2D kernel is applied at each pixel (the reference method)
+		    SMOOTH_SEPARABLE,  ///< Two 1D passes: exact for circular or axis-aligned kernels
+		    SMOOTH_SHEARED,    ///< A 1D pass, then one along a sheared axis: approximate, for rotated kernels
+		    SMOOTH_FFT         ///< The full 2D kernel, applied by multiplying Fourier transforms
+};
+
 /// @brief
 ///  Define a Gaussian to smooth a 2D array.
 /// @details
@@ -70,8 +80,24 @@ public:
   /// @brief Smooth an array with the Gaussian kernel
   Type *smooth(Type *input, size_t xdim, size_t ydim, EDGES edgeTreatment=EQUALTOEDGE);  
   /// @brief Smooth an array with the Gaussian kernel, using a mask to define blank pixels
-  Type *smooth(Type *input, size_t xdim, size_t ydim, std::vector<bool> mask, EDGES edgeTreatment=EQUALTOEDGE);  
-  
+  Type *smooth(Type *input, size_t xdim, size_t ydim, const std::vector<bool> &mask, EDGES edgeTreatment=EQUALTOEDGE);  
+  /// @brief Smooth an array into a given output array, using part of a larger mask
+  void  smooth(Type *input, size_t xdim, size_t ydim, const std::vector<bool> &mask, size_t maskOffset,
+	       Type *output, EDGES edgeTreatment=EQUALTOEDGE);
+
+  /// @brief Set the method used for the convolution
+  void   setMethod(SMOOTHMETHOD m){method=m;};
+  SMOOTHMETHOD getMethod(){return method;};
+  /// @brief The method that smooth() will use for the current kernel and an array of the given size
+  SMOOTHMETHOD chooseMethod(size_t xdim, size_t ydim);
+  /// @brief Get ready to smooth arrays of the given size, so that smooth() can then be called from several threads at once
+  void   prepare(size_t xdim, size_t ydim);
+  /// @brief Set the most memory, in bytes, that the FFT may use for SMOOTH_AUTO to choose it
+  void   setFFTMemoryLimit(size_t bytes){fftMemoryLimit=bytes;};
+  size_t getFFTMemoryLimit(){return fftMemoryLimit;};
+  /// @brief Can the kernel be written as the product of a function of x and a function of y?
+  bool   isSeparable();
+
   void   setKernMaj(float f){kernMaj=f;};
   void   setKernMin(float f){kernMin=f;};
   void   setKernPA(float f){kernPA=f;};
@@ -88,6 +114,25 @@ public:
     bool isAllocated(){return allocated;};
 
 private:
+  /// @brief The coefficients of the exponent of the kernel, as a function of pixel offset
+  void   quadraticForm(double &a, double &b, double &c);
+  /// @brief Smooth by applying the full 2D kernel at each pixel
+  void   smoothDense(Type *input, size_t xdim, size_t ydim, const std::vector<bool> &mask, size_t maskOffset,
+		     EDGES edgeTreatment, Type *output);
+  /// @brief Smooth with two 1D passes, the second along a (possibly) sheared axis
+  void   smoothTwoPass(Type *input, size_t xdim, size_t ydim, const std::vector<bool> &mask, size_t maskOffset,
+		       EDGES edgeTreatment, bool useShear, Type *output);
+  /// @brief Convolve an array with the kernel, as two 1D passes
+  double convolveTwoPass(const std::vector<double> &values, size_t xdim, size_t ydim, bool useShear, std::vector<double> &result);
+  /// @brief The Fourier transform of the kernel, padded to the lengths of the given Plans
+  void   transformKernel(const FFT::Plan &xplan, const FFT::Plan &yplan, std::vector<std::complex<double> > &kernFT);
+  /// @brief Smooth by multiplying the Fourier transforms of the array and the kernel
+  void   smoothFFT(Type *input, size_t xdim, size_t ydim, const std::vector<bool> &mask, size_t maskOffset,
+		   EDGES edgeTreatment, Type *output);
+  /// @brief Apply the mask, coverage scaling and edge treatment to a convolved array
+  void   finishSmoothing(Type *input, size_t xdim, size_t ydim, const std::vector<bool> &mask, size_t maskOffset, EDGES edgeTreatment,
+			 std::vector<double> &smoothed, const std::vector<double> &coverage, double kernsum, Type *output);
+
   float  kernMaj;      ///< The FWHM of the major axis of the elliptical Gaussian.
   float  kernMin;      ///< The FWHM of the minor axis of the elliptical Gaussian.
   float  kernPA;       ///< The position angle of the elliptical Gaussian.
@@ -96,6 +141,10 @@ private:
   Type  *kernel;       ///< The coefficients of the smoothing kernel
   bool   allocated;    ///< Have the coefficients been allocated in memory?
   Type   blankVal;     ///< What value to set blanks (when doing TRUNCATE mode)
+  SMOOTHMETHOD method; ///< How the convolution is done
+  std::vector<std::complex<double> > kernelFT; ///< The Fourier transform of the kernel, padded for the array size given to prepare()
+  size_t fftXlen;      ///< The padded x-dimension of kernelFT
+  size_t fftMemoryLimit; ///< The most memory, in bytes, that an automatically chosen FFT may use
 
 };
 
@@ -27,7 +27,9 @@
 // -----------------------------------------------------------------------
 #include <iostream>
 #include <math.h>
+#include <vector>
 #include <duchamp/Utils/Hanning.hh>
+#include <duchamp/Utils/SpectralConvolution.hh>
 
 Hanning::Hanning(){
   allocated=false;
@@ -39,6 +41,7 @@ Hanning::~Hanning(){
 
 Hanning::Hanning(const Hanning& h)
 {
+  this->allocated=false;
   operator=(h);
 }
 
@@ -46,6 +49,7 @@ Hanning& Hanning::operator=(const Hanning& h)
 {
   if(this==&h) return *this;
   this->hanningSize = h.hanningSize;
+  if(this->allocated) delete [] this->coeffs;
   this->allocated = h.allocated;
   if(h.allocated){
     this->coeffs = new float[this->hanningSize];
@@ -110,15 +114,57 @@ float *Hanning::smooth(float *array, int npts)
   if(!this->allocated) return array;
   else{
     float *newarray = new float[npts];
-    float scale = (hanningSize+1.)/2.;
-    for(int i=0;i<npts;i++){
-      newarray[i] = 0.;
-      for(int j=0;j<hanningSize;j++){
-	int x = j-(hanningSize-1)/2;
-	if((i+x>0)&&(i+x<npts)) newarray[i]+=coeffs[j] * array[i+x];
-      }
-      newarray[i] /= scale;
-    }
+    std::vector<bool> mask(npts,true);
+    this->smoothSpectra(array,newarray,1,npts,mask);
     return newarray;
   }
 }
+
+void Hanning::smoothSpectra(float *input, float *output, size_t xySize, size_t zdim,
+			    const std::vector<bool> &mask, int numThreads)
+{
+  /// @details
+  /// Smooths each spectrum of a cube with the filter, working on
+  /// whole channel maps at a time (see convolveSpectra()). Values for
+  /// which the mask is false are treated as zero when smoothing their
+  /// neighbours, and are copied to the output unchanged. If the
+  /// coefficients have not been allocated, the input is copied to the
+  /// output.
+  /// 
+  /// \param input The cube to be smoothed.
+  /// \param output Where the smoothed cube is written.
+  /// \param xySize The number of pixels in each channel map.
+  /// \param zdim The number of channels.
+  /// \param mask Which values of the input are valid.
+  /// \param numThreads The number of threads to use.
+
+  this->smoothSpectra(input,output,xySize,zdim,0,zdim,mask,numThreads);
+}
+
+void Hanning::smoothSpectra(float *input, float *output, size_t xySize, size_t zdim,
+			    size_t firstChannel, size_t numChannels,
+			    const std::vector<bool> &mask, int numThreads)
+{
+  /// @details
+  /// As for the version that smooths the whole cube, but only
+  /// channels firstChannel to firstChannel+numChannels-1 are
+  /// calculated, and written to the start of the output array.
+  /// 
+  /// \param input The cube to be smoothed.
+  /// \param output Where the smoothed channels are written.
+  /// \param xySize The number of pixels in each channel map.
+  /// \param zdim The number of channels in the cube.
+  /// \param firstChannel The first channel to be calculated.
+  /// \param numChannels The number of channels to be calculated.
+  /// \param mask Which values of the input are valid.
+  /// \param numThreads The number of threads to use.
+
+  if(!this->allocated){
+    for(size_t i=0;i<xySize*numChannels;i++) output[i] = input[firstChannel*xySize+i];
+  }
+  else{
+    float scale = (hanningSize+1.)/2.;
+    convolveSpectra(input,output,xySize,zdim,firstChannel,numChannels,mask,
+		    this->coeffs,this->hanningSize,false,scale,numThreads);
+  }
+}
@@ -29,6 +29,9 @@
 #ifndef HANNING_H
 #define HANNING_H
 
+#include <vector>
+#include <stddef.h>
+
 /// @brief
 ///  Define a Hanning filter.
 /// @details
@@ -49,6 +52,13 @@ public:
   void define(int size); ///< Define the size and the array of coefficients.
 
   float *smooth(float *array, int npts);  ///< Smooth an array with the Hanning filter.
+  /// @brief Smooth every spectrum of a cube with the Hanning filter.
+  void smoothSpectra(float *input, float *output, size_t xySize, size_t zdim,
+		     const std::vector<bool> &mask, int numThreads=1);
+  /// @brief Smooth a range of channels of a cube with the Hanning filter.
+  void smoothSpectra(float *input, float *output, size_t xySize, size_t zdim,
+		     size_t firstChannel, size_t numChannels,
+		     const std::vector<bool> &mask, int numThreads=1);
     
 private:
   int hanningSize; ///< The full width of the filter (number of coefficients)
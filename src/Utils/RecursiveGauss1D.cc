@@ -0,0 +1,243 @@
+// -----------------------------------------------------------------------
+// RecursiveGauss1D.cc: Member functions for the RecursiveGauss1D class.
+// -----------------------------------------------------------------------
+// Copyright (C) 2006, Matthew Whiting, ATNF
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or (at your
+// option) any later version.
+//
+// Duchamp is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Duchamp; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA
+//
+// Correspondence concerning Duchamp may be directed to:
+//    Internet email: Matthew.Whiting [at] atnf.csiro.au
+//    Postal address: Dr. Matthew Whiting
+//                    Australia Telescope National Facility, CSIRO
+//                    PO Box 76
+//                    Epping NSW 1710
+//                    AUSTRALIA
+// -----------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <complex>
+#include <duchamp/Utils/RecursiveGauss1D.hh>
+
+// The poles of the filter for sigma=2 (van Vliet, Young & Verbeek
+// 1998, ICPR 2, 509: the third-order set that minimises the maximum
+// error). The first is one of a complex-conjugate pair.
+static const std::complex<double> complexPole(1.41650,1.00829);
+static const std::complex<double> realPole(1.86543,0.);
+
+RecursiveGauss1D::RecursiveGauss1D()
+{
+  this->defined=false;
+}
+
+RecursiveGauss1D::RecursiveGauss1D(float fwhm)
+{
+  this->defined=false;
+  this->define(fwhm);
+}
+
+double RecursiveGauss1D::variance(double q)
+{
+  /// @details
+  /// The variance of the impulse response of the forward-backward
+  /// filter when the sigma=2 poles are scaled by q.
+  std::complex<double> d0 = std::pow(complexPole,1./q), d2 = std::pow(realPole,1./q);
+  // The complex pair contributes twice the real part of one of them.
+  return 2.*std::real(2.*d0/((d0-1.)*(d0-1.))) + std::real(2.*d2/((d2-1.)*(d2-1.)));
+}
+
+void RecursiveGauss1D::define(float fwhm)
+{
+  /// @details
+  /// Calculates the coefficients of the recursive filter, and the
+  /// matrix that gives the starting state of the backward pass.
+  /// \param fwhm The full width at half maximum of the Gaussian, in
+  /// channels. The recursion is only defined for a standard deviation
+  /// of at least 0.5 channels, so smaller values are increased to that.
+
+  this->kernFWHM = fwhm;
+  this->sigma = std::max(0.5, fwhm / (2.*sqrt(2.*M_LN2)));
+
+  // For widths other than sigma=2 the poles d are moved to d^(1/q),
+  // with q chosen so that the variance of the forward-backward
+  // filter, the sum over the poles of 2d/(d-1)^2, is sigma^2.
+  double qlow=1.e-3, qhigh=1.e3, q=1.;
+  for(int iter=0;iter<100;iter++){
+    q = sqrt(qlow*qhigh);
+    if(this->variance(q) > this->sigma*this->sigma) qhigh=q;
+    else qlow=q;
+  }
+  std::complex<double> d[3];
+  d[0] = std::pow(complexPole,1./q);
+  d[1] = std::conj(d[0]);
+  d[2] = std::pow(realPole,1./q);
+  // The forward pass is w[n] = B x[n] + a1 w[n-1] + a2 w[n-2] + a3
+  // w[n-3], where the a's come from expanding the product of
+  // (1 - z^-1/d) over the poles, and B makes the gain at zero
+  // frequency one.
+  std::complex<double> p0=1./d[0], p1=1./d[1], p2=1./d[2];
+  this->coeffs[0] = std::real(p0+p1+p2);
+  this->coeffs[1] = -std::real(p0*p1+p0*p2+p1*p2);
+  this->coeffs[2] = std::real(p0*p1*p2);
+  this->scale = 1. - (this->coeffs[0] + this->coeffs[1] + this->coeffs[2]);
+
+  // The data beyond the end of the spectrum are taken to be zero, so
+  // there the forward pass carries on from its last three values with
+  // no input, and the backward pass starts from zero once that has
+  // died away. Everything is linear, so run this once for each of the
+  // last three forward values to get the matrix that maps them onto
+  // the first three values of the backward pass beyond the end.
+  // Make this long enough for the response to the slowest pole to
+  // decay to below 1e-17.
+  double slowest = std::min(std::abs(d[0]),std::abs(d[2]));
+  size_t length = size_t(40./log(slowest)) + 10;
+  std::vector<double> w(length+3), y(length+3);
+  for(int k=0;k<3;k++){
+    std::fill(w.begin(),w.end(),0.);
+    std::fill(y.begin(),y.end(),0.);
+    w[2-k] = 1.;   // w[0],w[1],w[2] are the values at N-3,N-2,N-1
+    for(size_t n=3;n<length;n++)
+      w[n] = this->coeffs[0]*w[n-1] + this->coeffs[1]*w[n-2] + this->coeffs[2]*w[n-3];
+    for(size_t n=length;n-->3;)
+      y[n] = this->scale*w[n] + this->coeffs[0]*y[n+1] + this->coeffs[1]*y[n+2] + this->coeffs[2]*y[n+3];
+    for(int i=0;i<3;i++) this->endState[3*i+k] = y[3+i];
+  }
+
+  this->defined = true;
+}
+
+float *RecursiveGauss1D::smooth(float *input, int dim, const std::vector<bool> &mask)
+{
+  /// @details
+  /// Smooths a single spectrum. Values for which the mask is false
+  /// are left unchanged. If the filter has not been defined, the
+  /// input array is returned.
+  /// \param input The array to be smoothed.
+  /// \param dim The size of the array.
+  /// \param mask Which values of the array are valid.
+  /// \return A new array holding the smoothed values.
+
+  if(!this->defined) return input;
+  float *output = new float[dim];
+  this->smoothSpectra(input,output,1,dim,mask);
+  return output;
+}
+
+void RecursiveGauss1D::smoothSpectra(float *input, float *output, size_t xySize, size_t zdim,
+				     const std::vector<bool> &mask, int numThreads)
+{
+  /// @details
+  /// Smooths each spectrum of a cube. As for convolveSpectra(), the
+  /// spatial pixels are divided into tiles that are shared between
+  /// the threads, and each step of the recursion is done for a whole
+  /// tile at a time, so the loops have unit stride. The forward and
+  /// backward passes need the whole spectrum, so each tile holds the
+  /// data and the mask for all channels, in double precision.
+  ///
+  /// Values for which the mask is false do not contribute to the
+  /// smoothed values, and are copied to the output unchanged. If the
+  /// filter has not been defined, the input is copied to the output.
+  ///
+  /// \param input The cube to be smoothed.
+  /// \param output Where the smoothed cube is written.
+  /// \param xySize The number of pixels in each channel map.
+  /// \param zdim The number of channels.
+  /// \param mask Which values of the input are valid.
+  /// \param numThreads The number of threads to use.
+
+  if(!this->defined){
+    for(size_t i=0;i<xySize*zdim;i++) output[i] = input[i];
+    return;
+  }
+  if(xySize==0 || zdim==0) return;
+
+  const double B=this->scale, a1=this->coeffs[0], a2=this->coeffs[1], a3=this->coeffs[2];
+  // Keep each tile's buffers to around a MB
+  const size_t tileSize = std::min(xySize, std::max(size_t(16), size_t(65536/(zdim+6))));
+  const long numTiles = long((xySize+tileSize-1)/tileSize);
+  // Three planes of zeros before the first channel, and three for
+  // the starting state of the backward pass after the last.
+  const size_t length = zdim+6;
+
+#pragma omp parallel num_threads(numThreads)
+  {
+    std::vector<double> data(length*tileSize), cover(length*tileSize);
+
+#pragma omp for schedule(dynamic)
+    for(long tile=0;tile<numTiles;tile++){
+      size_t start = tile*tileSize;
+      size_t npix = std::min(tileSize, xySize-start);
+      double *d = &data[0];
+      double *c = &cover[0];
+
+      for(size_t i=0;i<3*tileSize;i++) d[i] = c[i] = 0.;
+      for(size_t z=0;z<zdim;z++){
+	size_t offset = z*xySize + start;
+	double *dz = d + (z+3)*tileSize;
+	double *cz = c + (z+3)*tileSize;
+	for(size_t p=0;p<npix;p++){
+	  bool good = mask[offset+p];
+	  dz[p] = good ? input[offset+p] : 0.;
+	  cz[p] = good ? 1. : 0.;
+	}
+      }
+
+      // Forward pass
+      for(size_t z=3;z<zdim+3;z++){
+	double *dz=d+z*tileSize, *cz=c+z*tileSize;
+	const double *d1=dz-tileSize, *d2=dz-2*tileSize, *d3=dz-3*tileSize;
+	const double *c1=cz-tileSize, *c2=cz-2*tileSize, *c3=cz-3*tileSize;
+	for(size_t p=0;p<npix;p++){
+	  dz[p] = B*dz[p] + a1*d1[p] + a2*d2[p] + a3*d3[p];
+	  cz[p] = B*cz[p] + a1*c1[p] + a2*c2[p] + a3*c3[p];
+	}
+      }
+
+      // Starting state for the backward pass
+      for(int i=0;i<3;i++){
+	double *dz=d+(zdim+3+i)*tileSize, *cz=c+(zdim+3+i)*tileSize;
+	const double *d1=d+(zdim+2)*tileSize, *d2=d1-tileSize, *d3=d2-tileSize;
+	const double *c1=c+(zdim+2)*tileSize, *c2=c1-tileSize, *c3=c2-tileSize;
+	const double m1=this->endState[3*i], m2=this->endState[3*i+1], m3=this->endState[3*i+2];
+	for(size_t p=0;p<npix;p++){
+	  dz[p] = m1*d1[p] + m2*d2[p] + m3*d3[p];
+	  cz[p] = m1*c1[p] + m2*c2[p] + m3*c3[p];
+	}
+      }
+
+      // Backward pass
+      for(size_t z=zdim+3;z-->3;){
+	double *dz=d+z*tileSize, *cz=c+z*tileSize;
+	const double *d1=dz+tileSize, *d2=dz+2*tileSize, *d3=dz+3*tileSize;
+	const double *c1=cz+tileSize, *c2=cz+2*tileSize, *c3=cz+3*tileSize;
+	for(size_t p=0;p<npix;p++){
+	  dz[p] = B*dz[p] + a1*d1[p] + a2*d2[p] + a3*d3[p];
+	  cz[p] = B*cz[p] + a1*c1[p] + a2*c2[p] + a3*c3[p];
+	}
+      }
+
+      for(size_t z=0;z<zdim;z++){
+	size_t offset = z*xySize + start;
+	const double *dz=d+(z+3)*tileSize, *cz=c+(z+3)*tileSize;
+	for(size_t p=0;p<npix;p++){
+	  if(!mask[offset+p]) output[offset+p] = input[offset+p];
+	  else output[offset+p] = float(dz[p]/cz[p]);
+	}
+      }
+
+    }
+  }
+
+}
@@ -0,0 +1,167 @@
+// -----------------------------------------------------------------------
+// SpectralConvolution.cc: Convolve every spectrum of a cube with a
+//                         one-dimensional kernel, a channel at a time.
+// -----------------------------------------------------------------------
+// Copyright (C) 2006, Matthew Whiting, ATNF
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or (at your
+// option) any later version.
+//
+// Duchamp is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Duchamp; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA
+//
+// Correspondence concerning Duchamp may be directed to:
+//    Internet email: Matthew.Whiting [at] atnf.csiro.au
+//    Postal address: Dr. Matthew Whiting
+//                    Australia Telescope National Facility, CSIRO
+//                    PO Box 76
+//                    Epping NSW 1710
+//                    AUSTRALIA
+// -----------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <duchamp/Utils/SpectralConvolution.hh>
+
+template <class Type>
+void convolveSpectra(Type *input, Type *output, size_t xySize, size_t zdim,
+		     const std::vector<bool> &mask, const Type *coeffs, int width,
+		     bool scaleByCoverage, float scale, int numThreads)
+{
+  /// @details
+  ///  Smooths all channels of the cube -- see the version that takes
+  ///  a range of channels for details.
+
+  convolveSpectra(input,output,xySize,zdim,0,zdim,mask,coeffs,width,scaleByCoverage,scale,numThreads);
+}
+template void convolveSpectra<float>(float *input, float *output, size_t xySize, size_t zdim,
+				     const std::vector<bool> &mask, const float *coeffs, int width,
+				     bool scaleByCoverage, float scale, int numThreads);
+template void convolveSpectra<double>(double *input, double *output, size_t xySize, size_t zdim,
+				      const std::vector<bool> &mask, const double *coeffs, int width,
+				      bool scaleByCoverage, float scale, int numThreads);
+
+template <class Type>
+void convolveSpectra(Type *input, Type *output, size_t xySize, size_t zdim,
+		     size_t firstChannel, size_t numChannels,
+		     const std::vector<bool> &mask, const Type *coeffs, int width,
+		     bool scaleByCoverage, float scale, int numThreads)
+{
+  /// @details
+  ///  Convolves each spectrum of a cube (the values along the third
+  ///  axis at a given spatial pixel) with the given kernel. Values
+  ///  for which the mask is false do not contribute, and are copied
+  ///  to the output unchanged. The sum for each valid value is
+  ///  divided by the sum of the kernel coefficients that covered
+  ///  valid values, if scaleByCoverage is true, and then by scale.
+  ///
+  ///  The spatial pixels are divided into tiles, which are shared
+  ///  between the threads. For each tile, a ring of width channel
+  ///  maps holds the (masked) input channels that the current output
+  ///  channel needs, so each input value is read once, and the sums
+  ///  are accumulated over the tile with unit stride. The
+  ///  contributions to each value are added in the same order as the
+  ///  single-spectrum loops of Hanning::smooth() and
+  ///  GaussSmooth1D::smooth() would, so the results are the same.
+  ///
+  ///  Only the output channels firstChannel to
+  ///  firstChannel+numChannels-1 are calculated, so that a large cube
+  ///  can be smoothed a block of channels at a time.
+  ///
+  /// \param input The cube to be smoothed.
+  /// \param output Where the smoothed channels are written, starting
+  /// with firstChannel. Must not overlap the input.
+  /// \param xySize The number of spatial pixels in a channel map.
+  /// \param zdim The number of channels in the input cube.
+  /// \param firstChannel The first channel to be calculated.
+  /// \param numChannels The number of channels to be calculated.
+  /// \param mask Which values of the input are valid.
+  /// \param coeffs The kernel coefficients, centred on coeffs[width/2].
+  /// \param width The number of coefficients (should be odd).
+  /// \param scaleByCoverage Whether to divide by the sum of the coefficients used.
+  /// \param scale A further factor to divide each smoothed value by.
+  /// \param numThreads The number of threads to use.
+
+  if(xySize==0 || numChannels==0) return;
+
+  const long hw = width/2;
+  const long zfirst = long(firstChannel);
+  const long zlast = long(std::min(zdim, firstChannel+numChannels));
+  // Keep the ring of channel maps to a few hundred kB
+  const size_t tileSize = std::min(xySize, std::max(size_t(256), size_t(65536/width)));
+  const long numTiles = long((xySize+tileSize-1)/tileSize);
+
+#pragma omp parallel num_threads(numThreads)
+  {
+    std::vector<Type> planes(width*tileSize);
+    std::vector<Type> cover(scaleByCoverage ? width*tileSize : 0);
+    std::vector<Type> sum(tileSize);
+    std::vector<float> fsum(tileSize);
+
+#pragma omp for schedule(dynamic)
+    for(long tile=0;tile<numTiles;tile++){
+      size_t start = tile*tileSize;
+      size_t npix = std::min(tileSize, xySize-start);
+      long nextChan = std::max(0L, zfirst-hw);  // the first channel not yet in the ring
+
+      for(long z=zfirst;z<zlast;z++){
+
+	for(;nextChan<=z+hw && nextChan<long(zdim);nextChan++){
+	  size_t slot = (nextChan%width)*tileSize;
+	  size_t offset = nextChan*xySize + start;
+	  for(size_t p=0;p<npix;p++){
+	    bool good = mask[offset+p];
+	    planes[slot+p] = good ? input[offset+p] : Type(0.);
+	    if(scaleByCoverage) cover[slot+p] = good ? Type(1.) : Type(0.);
+	  }
+	}
+
+	std::fill(sum.begin(),sum.begin()+npix,Type(0.));
+	if(scaleByCoverage) std::fill(fsum.begin(),fsum.begin()+npix,0.f);
+
+	for(long j=0;j<width;j++){
+	  long chan = z+j-hw;
+	  if(chan<0 || chan>=long(zdim)) continue;
+	  const Type coeff = coeffs[j];
+	  const Type *plane = &planes[(chan%width)*tileSize];
+	  Type *acc = &sum[0];
+	  for(size_t p=0;p<npix;p++) acc[p] += coeff*plane[p];
+	  if(scaleByCoverage){
+	    const Type *cov = &cover[(chan%width)*tileSize];
+	    float *facc = &fsum[0];
+	    for(size_t p=0;p<npix;p++) facc[p] += coeff*cov[p];
+	  }
+	}
+
+	size_t offset = z*xySize + start;
+	Type *out = output + (z-zfirst)*xySize + start;
+	for(size_t p=0;p<npix;p++){
+	  if(!mask[offset+p]) out[p] = input[offset+p];
+	  else{
+	    Type value = sum[p];
+	    if(scaleByCoverage) value /= fsum[p];
+	    if(scale!=1.) value /= scale;
+	    out[p] = value;
+	  }
+	}
+
+      }
+    }
+  }
+
+}
+template void convolveSpectra<float>(float *input, float *output, size_t xySize, size_t zdim,
+				     size_t firstChannel, size_t numChannels,
+				     const std::vector<bool> &mask, const float *coeffs, int width,
+				     bool scaleByCoverage, float scale, int numThreads);
+template void convolveSpectra<double>(double *input, double *output, size_t xySize, size_t zdim,
+				      size_t firstChannel, size_t numChannels,
+				      const std::vector<bool> &mask, const double *coeffs, int width,
+				      bool scaleByCoverage, float scale, int numThreads);
@@ -0,0 +1,54 @@
+// -----------------------------------------------------------------------
+// SpectralConvolution.hh: Convolve every spectrum of a cube with a
+//                         one-dimensional kernel, a channel at a time.
+// -----------------------------------------------------------------------
+// Copyright (C) 2006, Matthew Whiting, ATNF
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or (at your
+// option) any later version.
+//
+// Duchamp is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Duchamp; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA
+//
+// Correspondence concerning Duchamp may be directed to:
+//    Internet email: Matthew.Whiting [at] atnf.csiro.au
+//    Postal address: Dr. Matthew Whiting
+//                    Australia Telescope National Facility, CSIRO
+//                    PO Box 76
+//                    Epping NSW 1710
+//                    AUSTRALIA
+// -----------------------------------------------------------------------
+#ifndef SPECTRAL_CONVOLUTION_H
+#define SPECTRAL_CONVOLUTION_H
+
+#include <vector>
+#include <stddef.h>
+
+/// @brief Convolve each spectrum of a cube with a one-dimensional kernel.
+/// @details
+///  Rather than extracting each spectrum in turn, this works on
+///  whole channel maps: channel z of the output is the weighted sum
+///  of input channels z-hw to z+hw, where hw is the half-width of
+///  the kernel. Used by Hanning and GaussSmooth1D, which provide the
+///  kernels.
+template <class Type>
+void convolveSpectra(Type *input, Type *output, size_t xySize, size_t zdim,
+		     const std::vector<bool> &mask, const Type *coeffs, int width,
+		     bool scaleByCoverage, float scale, int numThreads=1);
+
+/// @brief Convolve each spectrum of a cube with a one-dimensional kernel, for a range of channels only.
+template <class Type>
+void convolveSpectra(Type *input, Type *output, size_t xySize, size_t zdim,
+		     size_t firstChannel, size_t numChannels,
+		     const std::vector<bool> &mask, const Type *coeffs, int width,
+		     bool scaleByCoverage, float scale, int numThreads=1);
+
+#endif  // SPECTRAL_CONVOLUTION_H
@@ -91,6 +91,7 @@ namespace Statistics
     bool  getRobust(){return useRobust;};
     void  setRobust(bool b){useRobust=b;};
     bool  setUseFDR(){return useFDR;};
+    bool  getUseFDR(){return useFDR;};
     void  setUseFDR(bool b){useFDR=b;};
 
     /// @brief Return the threshold as a signal-to-noise ratio. 
@@ -139,7 +140,7 @@ namespace Statistics
     void calculate(Type *array, long size);
 
     /// @brief Calculate statistics for a subset of a data array 
-    void calculate(Type *array, long size, std::vector<bool> mask);
+    void calculate(Type *array, long size, const std::vector<bool> &mask);
 
     void writeToBinaryFile(std::string filename);
     std::streampos readFromBinaryFile(std::string filename, std::streampos loc=0);
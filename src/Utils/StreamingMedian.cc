@@ -0,0 +1,292 @@
+// -----------------------------------------------------------------------
+// StreamingMedian.cc: Member functions for the StreamingMedian class.
+// -----------------------------------------------------------------------
+// Copyright (C) 2006, Matthew Whiting, ATNF
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or (at your
+// option) any later version.
+//
+// Duchamp is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Duchamp; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA
+//
+// Correspondence concerning Duchamp may be directed to:
+//    Internet email: Matthew.Whiting [at] atnf.csiro.au
+//    Postal address: Dr. Matthew Whiting
+//                    Australia Telescope National Facility, CSIRO
+//                    PO Box 76
+//                    Epping NSW 1710
+//                    AUSTRALIA
+// -----------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <duchamp/Utils/StreamingMedian.hh>
+#include <duchamp/Utils/utils.hh>
+
+namespace Statistics
+{
+
+  StreamingMedian::StreamingMedian(size_t capacity, size_t numBins)
+  {
+    /// @details
+    /// \param capacity The largest number of values that will be
+    /// kept in memory for the final pass.
+    /// \param numBins The number of bins in the histograms used to
+    /// narrow down the range. Each pass reduces the number of
+    /// candidate values by roughly this factor.
+
+    this->capacity = std::max(capacity,size_t(2));
+    this->numBins = std::max(numBins,size_t(2));
+    this->mode = RANGE;
+    this->finished = false;
+    this->sizeKnown = false;
+    this->size = 0;
+    this->numBelow = this->numAbove = this->numInside = 0;
+    this->low = this->high = 0.;
+    this->binScale = 0.;
+    this->median = 0.;
+  }
+  //--------------------------------------------------------------------
+
+  size_t StreamingMedian::memoryUsage(size_t capacity, size_t numBins)
+  {
+    return capacity*sizeof(float) + numBins*(sizeof(size_t)+2*sizeof(float));
+  }
+  //--------------------------------------------------------------------
+
+  void StreamingMedian::setRange(float low, float high)
+  {
+    /// @details
+    /// If the values are known to lie within a given range, the
+    /// first pass can go straight to histogramming them. If the
+    /// range turns out not to hold the middle values after all, a
+    /// pass to find the true range is made instead, so the result is
+    /// still correct.
+    /// \param low The lowest possible value.
+    /// \param high The highest possible value.
+
+    if(this->sizeKnown || this->finished) return;
+    this->low = low;
+    this->high = high;
+    this->prepareHistogram();
+  }
+  //--------------------------------------------------------------------
+
+  void StreamingMedian::prepareHistogram()
+  {
+    this->mode = HISTOGRAM;
+    this->binCount.assign(this->numBins,0);
+    this->binMin.resize(this->numBins);
+    this->binMax.resize(this->numBins);
+    if(this->high>this->low)
+      this->binScale = double(this->numBins)/(double(this->high)-double(this->low));
+    else
+      this->binScale = 0.;
+  }
+  //--------------------------------------------------------------------
+
+  void StreamingMedian::startPass()
+  {
+    this->numBelow = this->numAbove = this->numInside = 0;
+    if(this->mode==HISTOGRAM)
+      std::fill(this->binCount.begin(),this->binCount.end(),0);
+    else if(this->mode==COLLECT)
+      this->values.clear();
+  }
+  //--------------------------------------------------------------------
+
+  void StreamingMedian::endPass()
+  {
+    /// @details
+    /// Uses the results of the pass that has just finished to decide
+    /// what the next one should do. Once the middle values have been
+    /// found, the median is calculated in the same way as
+    /// findMedian() does, and needsPass() will return false.
+
+    if(!this->sizeKnown){
+      this->size = this->numBelow + this->numInside + this->numAbove;
+      this->sizeKnown = true;
+    }
+    if(this->size==0){
+      this->median = 0.;
+      this->finished = true;
+      return;
+    }
+
+    bool isEven = ((this->size%2)==0);
+    size_t upperRank = this->size/2;
+    size_t lowerRank = isEven ? upperRank-1 : upperRank;
+    float lowerValue=0.,upperValue=0.;
+
+    switch(this->mode){
+    case RANGE:
+      if(this->low==this->high){
+	lowerValue = upperValue = this->low;
+	this->finished = true;
+      }
+      else if(this->size <= this->capacity){
+	this->mode = COLLECT;
+	this->values.reserve(this->size);
+      }
+      else this->prepareHistogram();
+      break;
+
+    case HISTOGRAM:
+      if(lowerRank < this->numBelow || upperRank >= this->numBelow+this->numInside){
+	// The range given to setRange() did not hold the middle
+	// values, so start again by finding the full range.
+	this->mode = RANGE;
+      }
+      else{
+	size_t cumulative=this->numBelow, lowerBin=0, upperBin=0, numLeft=0;
+	bool foundLower=false;
+	for(size_t bin=0;bin<this->numBins;bin++){
+	  if(!foundLower && cumulative+this->binCount[bin] > lowerRank){
+	    lowerBin = bin;
+	    foundLower = true;
+	  }
+	  if(foundLower) numLeft += this->binCount[bin];
+	  if(cumulative+this->binCount[bin] > upperRank){
+	    upperBin = bin;
+	    break;
+	  }
+	  cumulative += this->binCount[bin];
+	}
+	this->low = this->binMin[lowerBin];
+	this->high = this->binMax[upperBin];
+	if(lowerBin!=upperBin){
+	  // The two middle values are adjacent in rank, so they are
+	  // the largest of the lower bin and the smallest of the upper.
+	  lowerValue = this->binMax[lowerBin];
+	  upperValue = this->binMin[upperBin];
+	  this->finished = true;
+	}
+	else if(this->low==this->high){
+	  lowerValue = upperValue = this->low;
+	  this->finished = true;
+	}
+	else if(numLeft <= this->capacity){
+	  this->mode = COLLECT;
+	  this->values.reserve(numLeft);
+	}
+	else this->prepareHistogram();
+      }
+      break;
+
+    case COLLECT:
+      {
+	size_t upper = upperRank - this->numBelow;
+	std::nth_element(this->values.begin(), this->values.begin()+upper, this->values.end());
+	upperValue = this->values[upper];
+	if(isEven)
+	  lowerValue = *std::max_element(this->values.begin(), this->values.begin()+upper);
+	this->finished = true;
+      }
+      break;
+    }
+
+    if(this->finished){
+      this->median = upperValue;
+      if(isEven){
+	this->median += lowerValue;
+	this->median /= float(2);
+      }
+      std::vector<float>().swap(this->values);
+      std::vector<size_t>().swap(this->binCount);
+      std::vector<float>().swap(this->binMin);
+      std::vector<float>().swap(this->binMax);
+    }
+  }
+  //--------------------------------------------------------------------
+
+  float findMedianStreaming(const float *array, const std::vector<bool> &mask, size_t size,
+			    size_t capacity)
+  {
+    /// @details
+    /// Finds the median of the values of an array for which the mask
+    /// is true. The result is the same as that of findMedian(), but
+    /// rather than copying the good values and partially sorting
+    /// them, a StreamingMedian makes several passes through the
+    /// array, so the memory used does not depend on the size of the
+    /// array.
+    /// \param array The array of values.
+    /// \param mask Which elements of the array to use.
+    /// \param size The number of elements in the array.
+    /// \param capacity The largest number of values to store.
+    /// \return The median of the masked values.
+
+    StreamingMedian med(capacity);
+    while(med.needsPass()){
+      med.startPass();
+      for(size_t i=0;i<size;i++) if(mask[i]) med.add(array[i]);
+      med.endPass();
+    }
+    return med.getMedian();
+  }
+  //--------------------------------------------------------------------
+
+  float findMADFMStreaming(const float *array, const std::vector<bool> &mask, size_t size,
+			   size_t capacity)
+  {
+    /// @details
+    /// Finds the median absolute deviation from the median of the
+    /// masked values of an array, giving the same result as
+    /// findMADFM(). Both medians are found with a StreamingMedian.
+    /// \param array The array of values.
+    /// \param mask Which elements of the array to use.
+    /// \param size The number of elements in the array.
+    /// \param capacity The largest number of values to store.
+    /// \return The MADFM of the masked values.
+
+    float median = findMedianStreaming(array,mask,size,capacity);
+    StreamingMedian madfm(capacity);
+    while(madfm.needsPass()){
+      madfm.startPass();
+      for(size_t i=0;i<size;i++) if(mask[i]) madfm.add(absval(array[i]-median));
+      madfm.endPass();
+    }
+    return madfm.getMedian();
+  }
+  //--------------------------------------------------------------------
+
+  float findMADFMDiffStreaming(const float *first, const float *second, const std::vector<bool> &mask,
+			       size_t size, size_t capacity)
+  {
+    /// @details
+    /// Finds the median absolute deviation from the median of the
+    /// difference between two arrays, over the masked elements,
+    /// giving the same result as findMADFMDiff(). The difference is
+    /// calculated as it is needed in each pass, rather than being
+    /// stored.
+    /// \param first The first array.
+    /// \param second The array to be subtracted from the first.
+    /// \param mask Which elements of the arrays to use.
+    /// \param size The number of elements in the arrays.
+    /// \param capacity The largest number of values to store.
+    /// \return The MADFM of first-second.
+
+    StreamingMedian med(capacity);
+    while(med.needsPass()){
+      med.startPass();
+      for(size_t i=0;i<size;i++) if(mask[i]) med.add(first[i]-second[i]);
+      med.endPass();
+    }
+    float median = med.getMedian();
+
+    StreamingMedian madfm(capacity);
+    while(madfm.needsPass()){
+      madfm.startPass();
+      for(size_t i=0;i<size;i++) if(mask[i]) madfm.add(absval(first[i]-second[i]-median));
+      madfm.endPass();
+    }
+    return madfm.getMedian();
+  }
+
+}
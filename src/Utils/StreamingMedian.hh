@@ -0,0 +1,158 @@
+// -----------------------------------------------------------------------
+// StreamingMedian.hh: Definition of the StreamingMedian class, which
+//                     finds the exact median of a set of values that
+//                     is too large to be held in memory.
+// -----------------------------------------------------------------------
+// Copyright (C) 2006, Matthew Whiting, ATNF
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or (at your
+// option) any later version.
+//
+// Duchamp is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Duchamp; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA
+//
+// Correspondence concerning Duchamp may be directed to:
+//    Internet email: Matthew.Whiting [at] atnf.csiro.au
+//    Postal address: Dr. Matthew Whiting
+//                    Australia Telescope National Facility, CSIRO
+//                    PO Box 76
+//                    Epping NSW 1710
+//                    AUSTRALIA
+// -----------------------------------------------------------------------
+#ifndef STREAMING_MEDIAN_H
+#define STREAMING_MEDIAN_H
+
+#include <vector>
+#include <stddef.h>
+
+namespace Statistics
+{
+
+  /// @brief
+  ///  Find the exact median of a stream of values, using a bounded
+  ///  amount of memory.
+  /// @details
+  ///  The values are not stored. Instead, the caller makes a number
+  ///  of passes through them, offering each value to add() in each
+  ///  pass. The first pass finds the range (unless it has been given
+  ///  with setRange()), and subsequent passes histogram the values to
+  ///  narrow down the range holding the middle value(s), until few
+  ///  enough remain to be kept and partially sorted. The result is
+  ///  exactly the value that findMedian() would give for the same set
+  ///  of values, including the averaging of the two middle values
+  ///  when there is an even number of them. Typical use is:
+  ///  @code
+  ///  StreamingMedian med;
+  ///  while(med.needsPass()){
+  ///    med.startPass();
+  ///    for(...) med.add(value);
+  ///    med.endPass();
+  ///  }
+  ///  float median = med.getMedian();
+  ///  @endcode
+  ///  The same values, in any order, must be offered in every pass.
+
+  class StreamingMedian
+  {
+  public:
+    StreamingMedian(size_t capacity=1048576, size_t numBins=65536);
+    virtual ~StreamingMedian(){};
+
+    /// @brief Give a range that is known to hold all the values, saving the first pass.
+    void   setRange(float low, float high);
+
+    /// @brief Is another pass through the values needed?
+    bool   needsPass(){return !finished;};
+    /// @brief Prepare to receive the values for the next pass.
+    void   startPass();
+    /// @brief Offer a value to the current pass.
+    inline void add(float value);
+    /// @brief Finish the current pass, and work out what the next one needs to do.
+    void   endPass();
+
+    /// @brief The number of values in the stream (known after the first pass).
+    size_t getSize(){return size;};
+    /// @brief The median of the values. Only valid once needsPass() is false.
+    float  getMedian(){return median;};
+
+    /// @brief The approximate number of bytes used by an object with the given parameters.
+    static size_t memoryUsage(size_t capacity=1048576, size_t numBins=65536);
+
+  private:
+    enum Mode {RANGE, HISTOGRAM, COLLECT};
+
+    void   prepareHistogram();
+
+    Mode   mode;            ///< What the current pass is doing.
+    bool   finished;        ///< Has the median been found?
+    bool   sizeKnown;       ///< Has the number of values been counted?
+    size_t capacity;        ///< The maximum number of values to be stored.
+    size_t numBins;         ///< The number of histogram bins.
+    size_t size;            ///< The number of values in the stream.
+    size_t numBelow;        ///< The number of values below the current range.
+    size_t numAbove;        ///< The number of values above the current range.
+    size_t numInside;       ///< The number of values within the current range.
+    float  low;             ///< The lower end of the current range (inclusive).
+    float  high;            ///< The upper end of the current range (inclusive).
+    double binScale;        ///< The number of bins per unit value.
+    float  median;          ///< The result.
+    std::vector<size_t> binCount; ///< The histogram.
+    std::vector<float>  binMin;   ///< The smallest value in each bin.
+    std::vector<float>  binMax;   ///< The largest value in each bin.
+    std::vector<float>  values;   ///< The values kept in the final pass.
+  };
+
+  //--------------------------------------------------------------------
+  // Masked statistics of float arrays, giving the same results as
+  // the functions in utils.hh but storing at most capacity values.
+
+  /// @brief Find the median of the masked values of an array, without copying the array.
+  float findMedianStreaming(const float *array, const std::vector<bool> &mask, size_t size,
+			    size_t capacity=1048576);
+  /// @brief Find the MADFM of the masked values of an array, without copying the array.
+  float findMADFMStreaming(const float *array, const std::vector<bool> &mask, size_t size,
+			   size_t capacity=1048576);
+  /// @brief Find the MADFM of the difference between two arrays, without forming the difference.
+  float findMADFMDiffStreaming(const float *first, const float *second, const std::vector<bool> &mask,
+			       size_t size, size_t capacity=1048576);
+
+  //--------------------------------------------------------------------
+
+  inline void StreamingMedian::add(float value)
+  {
+    switch(mode){
+    case RANGE:
+      if(numInside==0 || value<low) low = value;
+      if(numInside==0 || value>high) high = value;
+      numInside++;
+      break;
+    case HISTOGRAM:
+      if(value<low) numBelow++;
+      else if(value>high) numAbove++;
+      else{
+	size_t bin = size_t((double(value)-double(low))*binScale);
+	if(bin>=numBins) bin = numBins-1;
+	if(binCount[bin]==0 || value<binMin[bin]) binMin[bin] = value;
+	if(binCount[bin]==0 || value>binMax[bin]) binMax[bin] = value;
+	binCount[bin]++;
+	numInside++;
+      }
+      break;
+    case COLLECT:
+      if(value<low) numBelow++;
+      else if(value<=high) values.push_back(value);
+      break;
+    }
+  }
+
+}
+
+#endif // STREAMING_MEDIAN_H
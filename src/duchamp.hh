@@ -150,6 +150,8 @@ Duchamp is an object finder for spectral-line FITS cubes.\n\
   const std::string keyword_kernpa       = "DU_KPA"; 
   /// FITS header keyword for the Hanning filter width
   const std::string keyword_hanningwidth = "DU_WHANN"; 
+  /// FITS header keyword for the spectral gaussian FWHM
+  const std::string keyword_spectralfwhm = "DU_SFWHM"; 
   /// FITS header keyword for the image subsection used
   const std::string keyword_subsection   = "DU_IMSUB";
 
@@ -174,6 +176,8 @@ Duchamp is an object finder for spectral-line FITS cubes.\n\
   const std::string comment_kernpa       = "Duchamp parameter kernPA";
   /// FITS header comment for DU_WHANN keyword
   const std::string comment_hanningwidth = "Duchamp parameter hanningWidth";
+  /// FITS header comment for DU_SFWHM keyword
+  const std::string comment_spectralfwhm = "Duchamp parameter spectralFWHM";
   /// FITS header comment for DU_IMSUB keyword
   const std::string comment_subsection   = "Subsection of the original image";
 
@@ -198,6 +202,8 @@ Duchamp is an object finder for spectral-line FITS cubes.\n\
 	     "A subsection of the original was smoothed by " + PROGNAME;
   const std::string header_smoothSpatial = "Spatial, gaussian kernel";
   const std::string header_smoothSpectral= "Spectral, hanning filter";
+  const std::string header_smoothRecursive= "Spectral, recursive gaussian";
+  const std::string header_smooth3D      = "3D, hanning filter & gaussian kernel";
 
   // Descriptive Headers: for the output Mask image
   const std::string header_maskHistory =
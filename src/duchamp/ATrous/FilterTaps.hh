@@ -0,0 +1 @@
+../../ATrous/FilterTaps.hh
\ No newline at end of file
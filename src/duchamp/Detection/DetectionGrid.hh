@@ -0,0 +1 @@
+../../Detection/DetectionGrid.hh
\ No newline at end of file
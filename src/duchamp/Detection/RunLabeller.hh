@@ -0,0 +1 @@
+../../Detection/RunLabeller.hh
\ No newline at end of file
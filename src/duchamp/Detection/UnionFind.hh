@@ -0,0 +1 @@
+../../Detection/UnionFind.hh
\ No newline at end of file
@@ -0,0 +1 @@
+../../Utils/FFT.hh
\ No newline at end of file
@@ -0,0 +1 @@
+../../Utils/RecursiveGauss1D.hh
\ No newline at end of file
@@ -0,0 +1 @@
+../../Utils/SpectralConvolution.hh
\ No newline at end of file
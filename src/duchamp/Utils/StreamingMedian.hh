@@ -0,0 +1 @@
+../../Utils/StreamingMedian.hh
\ No newline at end of file
@@ -179,11 +179,13 @@ namespace duchamp
     this->flagSmooth        = false;
     this->smoothType        = "spectral";
     this->hanningWidth      = 5;
+    this->spectralFWHM      = 5.;
     this->kernMaj           = 3.;
     this->kernMin           = -1.;
     this->kernPA            = 0.;
     this->smoothEdgeMethod  = "equal";
     this->spatialSmoothCutoff = 1.e-10;
+    this->smoothMemory      = 0.;
     // A trous reconstruction parameters
     this->flagATrous        = false;
     this->reconDim          = 1;
@@ -191,6 +193,7 @@ namespace duchamp
     this->scaleMax          = 0;
     this->snrRecon          = 4.;
     this->reconConvergence  = 0.005;
+    this->reconMemory       = 0.;
     this->filterCode        = 1;
 //    this->reconFilter.define(this->filterCode);
     this->reconFilter = 0;
@@ -217,6 +220,7 @@ namespace duchamp
     this->borders           = true;
     this->blankEdge         = true;
     this->verbose           = true;
+    this->numThreads        = 1;
     this->commentStr        = "";
   }
 
@@ -328,17 +332,20 @@ namespace duchamp
     this->flagSmooth        = p.flagSmooth;
     this->smoothType        = p.smoothType;
     this->hanningWidth      = p.hanningWidth;
+    this->spectralFWHM      = p.spectralFWHM;
     this->kernMaj           = p.kernMaj;
     this->kernMin           = p.kernMin;
     this->kernPA            = p.kernPA;
     this->smoothEdgeMethod  = p.smoothEdgeMethod;
     this->spatialSmoothCutoff = p.spatialSmoothCutoff;
+    this->smoothMemory      = p.smoothMemory;
     this->flagATrous        = p.flagATrous;
     this->reconDim          = p.reconDim;
     this->scaleMin          = p.scaleMin;
     this->scaleMax          = p.scaleMax;
     this->snrRecon          = p.snrRecon;
     this->reconConvergence  = p.reconConvergence;
+    this->reconMemory       = p.reconMemory;
     this->filterCode        = p.filterCode;
     this->reconFilter       = p.reconFilter;
     this->flagAdjacent      = p.flagAdjacent;
@@ -362,6 +369,7 @@ namespace duchamp
     this->borders           = p.borders;
     this->blankEdge         = p.blankEdge;
     this->verbose           = p.verbose;
+    this->numThreads        = p.numThreads;
     this->commentStr        = p.commentStr;
     return *this;
   }
@@ -706,11 +714,13 @@ namespace duchamp
 	if(arg=="flagsmooth")      this->flagSmooth = readFlag(ss);
 	if(arg=="smoothtype")      this->smoothType = readSval(ss);
 	if(arg=="hanningwidth")    this->hanningWidth = readIval(ss);
+	if(arg=="spectralfwhm")    this->spectralFWHM = readFval(ss);
 	if(arg=="kernmaj")         this->kernMaj = readFval(ss);
 	if(arg=="kernmin")         this->kernMin = readFval(ss);
 	if(arg=="kernpa")          this->kernPA = readFval(ss);
 	if(arg=="smoothedgemethod") this->smoothEdgeMethod = readSval(ss);
 	if(arg=="spatialsmoothcutoff") this->spatialSmoothCutoff = readFval(ss);
+	if(arg=="smoothmemory")    this->smoothMemory = readFval(ss);
 
 	if(arg=="flagatrous")      this->flagATrous = readFlag(ss); 
 	if(arg=="recondim")        this->reconDim = readIval(ss); 
@@ -718,6 +728,7 @@ namespace duchamp
 	if(arg=="scalemax")        this->scaleMax = readIval(ss); 
 	if(arg=="snrrecon")        this->snrRecon = readFval(ss); 
 	if(arg=="reconconvergence") this->reconConvergence = readFval(ss);
+	if(arg=="reconmemory")     this->reconMemory = readFval(ss);
 	if(arg=="filtercode")      this->filterCode = readIval(ss); 
 
 	if(arg=="flagadjacent")    this->flagAdjacent = readFlag(ss); 
@@ -741,6 +752,7 @@ namespace duchamp
 	if(arg=="drawborders")     this->borders = readFlag(ss); 
 	if(arg=="drawblankedges")  this->blankEdge = readFlag(ss); 
 	if(arg=="verbose")         this->verbose = readFlag(ss); 
+	if(arg=="numthreads")      this->numThreads = readIval(ss);
 
 	// Dealing with deprecated parameters.
 	if(arg=="flagblankpix"){
@@ -811,9 +823,9 @@ namespace duchamp
     if(this->precVel<0)  this->precVel = 0;
     if(this->precSNR<0)  this->precSNR = 0;
 
-    // Can only have "spatial" or "spectral" as search types
-    if(this->searchType != "spatial" && this->searchType != "spectral"){
-      DUCHAMPWARN("Reading parameters","You have requested a search type of \""<<this->searchType<<"\" -- Only \"spectral\" and \"spatial\" are accepted, so setting to \"spatial\".");
+    // Can only have "spatial", "spectral" or "3D" as search types
+    if(this->searchType != "spatial" && this->searchType != "spectral" && this->searchType != "3D"){
+      DUCHAMPWARN("Reading parameters","You have requested a search type of \""<<this->searchType<<"\" -- Only \"spectral\", \"spatial\" and \"3D\" are accepted, so setting to \"spatial\".");
       this->searchType = "spatial";
     }
 
@@ -826,6 +838,10 @@ namespace duchamp
 	DUCHAMPWARN("Reading Parameters","Your reconConvergence value is negative ("<<this->reconConvergence<<") - setting to " << -this->reconConvergence <<".");
 	this->reconConvergence *= -1.;
       }
+      if(this->reconMemory < 0.){
+	DUCHAMPWARN("Reading Parameters","Your reconMemory value is negative ("<<this->reconMemory<<") - setting to 0, so that there is no limit.");
+	this->reconMemory = 0.;
+      }
 
 //      this->reconFilter.define(this->filterCode);
       FilterFactory filtFac;
@@ -853,16 +869,23 @@ namespace duchamp
 	
 	// Make sure smoothType is an acceptable type -- default is "spectral"
 	if((this->smoothType!="spectral")&&
-	   (this->smoothType!="spatial")){
+	   (this->smoothType!="spatial")&&
+	   (this->smoothType!="recursive")&&
+	   (this->smoothType!="3D")){
 	    DUCHAMPWARN("Reading parameters","The requested value of the parameter smoothType, \"" << this->smoothType << "\", is invalid -- changing to \"spectral\".");
 	    this->smoothType = "spectral";
 	}
 
+	if(this->smoothType=="recursive" && this->spectralFWHM<=0.){
+	    DUCHAMPWARN("Reading parameters","The value of spectralFWHM (" << this->spectralFWHM << ") needs to be positive. Changing to 5.");
+	    this->spectralFWHM = 5.;
+	}
+
 	// If kernMin has not been given, or is negative, make it equal to kernMaj
 	if(this->kernMin < 0) this->kernMin = this->kernMaj;
 	
 	// Check the smoothEdgeMethod and spatialSmoothCutoff parameters.
-	if(this->smoothType=="spatial"){
+	if(this->smoothType=="spatial" || this->smoothType=="3D"){
 	    if((this->smoothEdgeMethod != "equal") && (this->smoothEdgeMethod!="truncate") && (this->smoothEdgeMethod!="scale")){
 		DUCHAMPWARN("Reading parameters","The requested value of the parameter smoothEdgeMethod, \""<< this->smoothEdgeMethod << "\", is invalid - changing to \"equal\".");
 		this->smoothEdgeMethod = "equal";
@@ -873,6 +896,11 @@ namespace duchamp
 	    }
 	}
 
+	if(this->smoothMemory < 0.){
+	    DUCHAMPWARN("Reading Parameters","Your smoothMemory value is negative ("<<this->smoothMemory<<") - setting to 0, so that there is no limit.");
+	    this->smoothMemory = 0.;
+	}
+
     }
 
     if(this->flagUserThreshold){
@@ -939,6 +967,18 @@ namespace duchamp
       this->pixelCentre = "centroid";
     }
 
+    // Make sure the number of threads is sensible
+    if(this->numThreads < 1){
+      DUCHAMPWARN("Reading parameters","The requested value of the parameter numThreads, " << this->numThreads << ", is invalid -- changing to 1.");
+      this->numThreads = 1;
+    }
+#ifndef HAVE_OPENMP
+    if(this->numThreads > 1){
+      DUCHAMPWARN("Reading parameters","Duchamp has not been compiled with OpenMP support, so setting numThreads to 1.");
+      this->numThreads = 1;
+    }
+#endif
+
     // Make sure sortingParam is an acceptable type -- default is "vel"
     bool OK = false;
     int loc=(this->sortingParam[0]=='-') ? 1 : 0;
@@ -1117,15 +1157,19 @@ namespace duchamp
     recordParam(theStream, par, "[flagSmooth]", "Smoothing data prior to searching?", stringize(par.getFlagSmooth()));
     if(par.getFlagSmooth()){	       
       recordParam(theStream, par, "[smoothType]", "Type of smoothing", par.getSmoothType());
-      if(par.getSmoothType()=="spectral")
+      if(par.getSmoothType()=="spectral" || par.getSmoothType()=="3D")
 	recordParam(theStream, par, "[hanningWidth]", "Width of hanning filter", par.getHanningWidth());
-      else{
+      if(par.getSmoothType()=="recursive")
+	recordParam(theStream, par, "[spectralFWHM]", "Gaussian spectral kernel FWHM [chan]", par.getSpectralFWHM());
+      if(par.getSmoothType()=="spatial" || par.getSmoothType()=="3D"){
 	recordParam(theStream, par, "[kernMaj]", "Gaussian kernel major axis FWHM [pix]", par.getKernMaj());
 	recordParam(theStream, par, "[kernMin]", "Gaussian kernel minor axis FWHM [pix]", par.getKernMin());
 	recordParam(theStream, par, "[kernPA]",  "Gaussian kernel position angle [deg]",  par.getKernPA());
 	recordParam(theStream, par, "[smoothEdgeMethod]","Method for treating edge pixels", par.getSmoothEdgeMethod());
 	recordParam(theStream, par, "[spatialSmoothCutoff]","Cutoff value for determining kernel", par.getSpatialSmoothCutoff());
       }
+      if(par.getSmoothMemory()>0.)
+	recordParam(theStream, par, "[smoothMemory]", "Memory budget for smoothed search [MB]", par.getSmoothMemory());
     }
     recordParam(theStream, par, "[flagATrous]", "Using A Trous reconstruction?", stringize(par.getFlagATrous()));
     if(par.getFlagATrous()){			       
@@ -1138,6 +1182,8 @@ namespace duchamp
       }
       recordParam(theStream, par, "[snrRecon]", "SNR Threshold within reconstruction", par.getAtrousCut());
       recordParam(theStream, par, "[reconConvergence]", "Residual convergence criterion", par.getReconConvergence());
+      if(par.getReconMemory()>0.)
+	recordParam(theStream, par, "[reconMemory]", "Memory budget for 3D reconstruction [MB]", par.getReconMemory());
       recordParam(theStream, par, "[filterCode]", "Filter being used for reconstruction", par.getFilterCode()<<" ("<<par.getFilterName()<<")");
     }	     					       
     recordParam(theStream, par, "[flagRobustStats]", "Using Robust statistics?", stringize(par.getFlagRobustStats()));
@@ -1181,6 +1227,9 @@ namespace duchamp
     recordParam(theStream, par, "[flagTwoStageMerging]", "Merge objects in two stages?", stringize(par.getFlagTwoStageMerging()));
     recordParam(theStream, par, "[spectralMethod]", "Method of spectral plotting", par.getSpectralMethod());
     recordParam(theStream, par, "[pixelCentre]", "Type of object centre used in results", par.getPixelCentre());
+    if(par.getNumThreads()>1){
+      recordParam(theStream, par, "[numThreads]", "Number of threads used in processing", par.getNumThreads());
+    }
 
     theStream  << par.commentString() <<"--------------------\n";
     theStream  << std::setfill(' ');
@@ -1246,18 +1295,23 @@ namespace duchamp
     vopars.push_back(VOParam("flagRejectBeforeMerge","","boolean",this->flagRejectBeforeMerge,0,""));
     vopars.push_back(VOParam("flagTwoStageMerging","","boolean",this->flagTwoStageMerging,0,""));
     vopars.push_back(VOParam("pixelCentre","","char",this->pixelCentre,this->pixelCentre.size(),""));
+    if(this->numThreads>1) vopars.push_back(VOParam("numThreads","","int",this->numThreads,0,""));
     vopars.push_back(VOParam("flagSmooth","meta.code","boolean",this->flagSmooth,0,""));
     if(this->flagSmooth){
       vopars.push_back(VOParam("smoothType","","char",this->smoothType,this->smoothType.size(),""));
-      if(this->smoothType=="spectral")
+      if(this->smoothType=="spectral" || this->smoothType=="3D")
 	vopars.push_back(VOParam("hanningWidth","","int",this->hanningWidth,0,""));
-      else{
+      if(this->smoothType=="recursive")
+	vopars.push_back(VOParam("spectralFWHM","","float",this->spectralFWHM,0,""));
+      if(this->smoothType=="spatial" || this->smoothType=="3D"){
 	vopars.push_back(VOParam("kernMaj","","float",this->kernMaj,0,""));
 	vopars.push_back(VOParam("kernMin","","float",this->kernMin,0,""));
 	vopars.push_back(VOParam("kernPA","","float",this->kernPA,0,""));
 	vopars.push_back(VOParam("smoothEdgeMethod","","char",this->smoothEdgeMethod,this->smoothEdgeMethod.size(),""));
 	vopars.push_back(VOParam("spatialSmoothCutoff","","float", this->spatialSmoothCutoff,0,""));
       }
+      if(this->smoothMemory>0.)
+	vopars.push_back(VOParam("smoothMemory","","float",this->smoothMemory,0,""));
     }
     vopars.push_back(VOParam("flagATrous","meta.code","boolean",this->flagATrous,0,""));
     if(this->flagATrous){
@@ -1267,6 +1321,8 @@ namespace duchamp
 	vopars.push_back(VOParam("scaleMax","","int",this->scaleMax,0,""));
       vopars.push_back(VOParam("snrRecon","","float",this->snrRecon,0,""));
       vopars.push_back(VOParam("reconConvergence","","float",this->reconConvergence,0,""));
+      if(this->reconMemory>0.)
+	vopars.push_back(VOParam("reconMemory","","float",this->reconMemory,0,""));
       vopars.push_back(VOParam("filterCode","","int",this->filterCode,0,""));
     }
     if(this->beamAsUsed.origin()==PARAM){
@@ -1283,6 +1339,30 @@ namespace duchamp
 
   }
 
+  /// @brief The code for each type of smoothing in the binary
+  /// catalogue. 0 and 1 are the values of the bool that earlier
+  /// versions wrote for spatial and spectral smoothing.
+  static char smoothTypeCode(std::string type)
+  {
+    if(type=="spectral")  return 1;
+    if(type=="recursive") return 2;
+    if(type=="3D")        return 3;
+    return 0;
+  }
+
+  /// @brief The type of smoothing with the given code, or an empty
+  /// string if the code is not known.
+  static std::string smoothTypeFromCode(char code)
+  {
+    switch(code){
+    case 0: return "spatial";
+    case 1: return "spectral";
+    case 2: return "recursive";
+    case 3: return "3D";
+    default: return "";
+    }
+  }
+
   void Param::writeToBinaryFile(std::string &filename)
   {
     std::ofstream outfile(filename.c_str(), std::ios::out | std::ios::binary | std::ios::app);
@@ -1345,11 +1425,17 @@ namespace duchamp
     outfile.write(reinterpret_cast<const char*>(&this->flagTwoStageMerging), sizeof this->flagTwoStageMerging);
     outfile.write(reinterpret_cast<const char*>(&this->flagSmooth), sizeof this->flagSmooth);
     if(this->flagSmooth){
-      bool type=(this->smoothType=="spectral");
+      // The type is stored as a single byte, with the values used by
+      // earlier versions (when it was a bool) kept for the spectral
+      // and spatial smoothing, so that their catalogues can still be
+      // read.
+      char type=smoothTypeCode(this->smoothType);
       outfile.write(reinterpret_cast<const char*>(&type), sizeof type);
-      if(type)
+      if(this->smoothType=="spectral" || this->smoothType=="3D")
 	outfile.write(reinterpret_cast<const char*>(&this->hanningWidth), sizeof this->hanningWidth);
-      else{
+      if(this->smoothType=="recursive")
+	outfile.write(reinterpret_cast<const char*>(&this->spectralFWHM), sizeof this->spectralFWHM);
+      if(this->smoothType=="spatial" || this->smoothType=="3D"){
 	outfile.write(reinterpret_cast<const char*>(&this->kernMaj), sizeof this->kernMaj);
 	outfile.write(reinterpret_cast<const char*>(&this->kernMin), sizeof this->kernMin);
 	outfile.write(reinterpret_cast<const char*>(&this->kernPA), sizeof this->kernPA);
@@ -1444,12 +1530,19 @@ namespace duchamp
     infile.read(reinterpret_cast<char*>(&this->flagTwoStageMerging), sizeof this->flagTwoStageMerging);
     infile.read(reinterpret_cast<char*>(&this->flagSmooth), sizeof this->flagSmooth);
     if(this->flagSmooth){
-      bool type;
+      char type;
       infile.read(reinterpret_cast<char*>(&type), sizeof type);
-      this->smoothType = type ? "spectral" : "spatial";
-      if(type)
+      this->smoothType = smoothTypeFromCode(type);
+      if(this->smoothType==""){
+	DUCHAMPERROR("read binary parameters","Unknown smoothing type (code " << int(type) << ") in binary catalogue \"" << filename << "\"");
+	infile.close();
+	return -1;
+      }
+      if(this->smoothType=="spectral" || this->smoothType=="3D")
 	infile.read(reinterpret_cast<char*>(&this->hanningWidth), sizeof this->hanningWidth);
-      else{
+      if(this->smoothType=="recursive")
+	infile.read(reinterpret_cast<char*>(&this->spectralFWHM), sizeof this->spectralFWHM);
+      if(this->smoothType=="spatial" || this->smoothType=="3D"){
 	infile.read(reinterpret_cast<char*>(&this->kernMaj), sizeof this->kernMaj);
 	infile.read(reinterpret_cast<char*>(&this->kernMin), sizeof this->kernMin);
 	infile.read(reinterpret_cast<char*>(&this->kernPA), sizeof this->kernPA);
@@ -1574,8 +1667,12 @@ namespace duchamp
     ///   the output will be:
     ///    <ul><li> Spectral smoothing: image.SMOOTH-1D-3.fits, where the
     ///             width of the Hanning filter was 3 pixels.
+    ///        <li> Recursive smoothing: image.SMOOTH-1DG-30.fits, where the
+    ///             FWHM of the Gaussian was 30 channels.
     ///        <li> Spatial smoothing : image.SMOOTH-2D-3-2-20-E-10.fits, where
     ///             kernMaj=3, kernMin=2 and kernPA=20 degrees, EQUAL edge method, and cutoff of 1.e-10.
+    ///        <li> 3D smoothing : image.SMOOTH-3D-5-3-2-20-E-10.fits, with a
+    ///             Hanning width of 5 and the spatial kernel as above.
     ///    </ul>
 
     if(this->fileOutputSmooth==""){
@@ -1584,13 +1681,16 @@ namespace duchamp
       if(this->flagSubsection) ss<<".sub";
       if(this->smoothType=="spectral")
 	ss << ".SMOOTH-1D-" << this->hanningWidth << ".fits";
-      else if(this->smoothType=="spatial"){
+      else if(this->smoothType=="recursive")
+	ss << ".SMOOTH-1DG-" << this->spectralFWHM << ".fits";
+      else if(this->smoothType=="spatial" || this->smoothType=="3D"){
 	  char method='X';
 	  if(this->smoothEdgeMethod=="equal") method='E';
 	  else if (this->smoothEdgeMethod=="truncate") method='T';
 	  else if (this->smoothEdgeMethod=="scale") method='S';
-	  ss << ".SMOOTH-2D-" 
-	     << this->kernMaj << "-"
+	  if(this->smoothType=="3D") ss << ".SMOOTH-3D-" << this->hanningWidth << "-";
+	  else ss << ".SMOOTH-2D-";
+	  ss << this->kernMaj << "-"
 	     << this->kernMin << "-"
 	     << this->kernPA  << "-"
 	     << method        << "-"
@@ -380,6 +380,8 @@ namespace duchamp
     void   setSmoothType(std::string s){smoothType=s;};
     int    getHanningWidth(){return hanningWidth;};
     void   setHanningWidth(int f){hanningWidth=f;};
+    float  getSpectralFWHM(){return spectralFWHM;};
+    void   setSpectralFWHM(float f){spectralFWHM=f;};
     void   setKernMaj(float f){kernMaj=f;};
     float  getKernMaj(){return kernMaj;};
     void   setKernMin(float f){kernMin=f;};
@@ -390,6 +392,8 @@ namespace duchamp
     void   setSmoothEdgeMethod(std::string s){smoothEdgeMethod=s;};  
     float getSpatialSmoothCutoff(){return spatialSmoothCutoff;};
     void setSpatialSmoothCutoff(float f){spatialSmoothCutoff=f;};  
+    float  getSmoothMemory(){return smoothMemory;};
+    void   setSmoothMemory(float f){smoothMemory = f;};
     //	 
     bool   getFlagATrous(){return flagATrous;};
     void   setFlagATrous(bool flag){flagATrous=flag;};
@@ -403,6 +407,8 @@ namespace duchamp
     void   setAtrousCut(float c){snrRecon=c;};
     float  getReconConvergence(){return reconConvergence;};
     void   setReconConvergence(float f){reconConvergence = f;};
+    float  getReconMemory(){return reconMemory;};
+    void   setReconMemory(float f){reconMemory = f;};
     int    getFilterCode(){return filterCode;};
     void   setFilterCode(int c){filterCode=c;};
     std::string getFilterName(){return reconFilter->getName();};
@@ -453,6 +459,9 @@ namespace duchamp
     /// @brief Are we in verbose mode? 
     bool   isVerbose(){return verbose;};
     void   setVerbosity(bool f){verbose=f;};
+    /// @brief How many threads to use in the multi-threaded parts of the processing?
+    int    getNumThreads(){return numThreads;};
+    void   setNumThreads(int i){numThreads=i;};
   
     /// @brief Set the comment characters
     void setCommentString(std::string comment){commentStr = comment;};
@@ -580,11 +589,13 @@ namespace duchamp
     bool        flagSmooth;      ///< Should the cube be smoothed before searching?
     std::string smoothType;      ///< The type of smoothing to be done.
     int         hanningWidth;    ///< Width for hanning smoothing.
+    float       spectralFWHM;    ///< FWHM, in channels, of the gaussian for recursive spectral smoothing.
     float       kernMaj;         ///< Semi-Major axis of gaussian smoothing kernel
     float       kernMin;         ///< Semi-Minor axis of gaussian smoothing kernel
     float       kernPA;          ///< Position angle of gaussian smoothing kernel, in degrees east of north (i.e. anticlockwise).
     std::string smoothEdgeMethod; ///< Method for dealing with the edges when 2D smoothing: 'equal','truncate','scale'
     float       spatialSmoothCutoff; ///< Cutoff value for determining kernel size
+    float       smoothMemory;    ///< Memory budget (in MB) for the smoothed search - if keeping the whole smoothed cube needs more than this, the cube is smoothed and searched a window at a time. Zero means no limit.
 
     // A trous reconstruction parameters
     bool   flagATrous;      ///< Are we using the a trous reconstruction?
@@ -593,6 +604,7 @@ namespace duchamp
     unsigned int    scaleMax;        ///< Max scale used in a trous reconstruction
     float  snrRecon;        ///< SNR cutoff used in a trous reconstruction (only wavelet coefficients that survive this threshold are kept)
     float  reconConvergence;///< Convergence criterion for reconstruction - maximum fractional change in residual standard deviation
+    float  reconMemory;     ///< Memory budget (in MB) for the 3D reconstruction - if the standard method needs more than this, the reconstruction is done plane by plane. Zero means no limit.
     Filter *reconFilter;     ///< The filter used for reconstructions.
     int    filterCode;      ///< The code number for the filter to be used (saves having to parse names)
 
@@ -620,6 +632,7 @@ namespace duchamp
     bool   borders;             ///< Whether to draw a border around the individual pixels of a detection in the spectral display
     bool   blankEdge;           ///< Whether to draw a border around the BLANK pixel region in the moment maps and cutout images
     bool   verbose;             ///< Whether to use maximum verbosity -- use progress indicators in the reconstruction & merging steps.
+    int    numThreads;          ///< The number of threads to use in the multi-threaded processing steps (only has an effect when compiled with OpenMP).
 
     std::string commentStr; ///< Any comment characters etc that need to be prepended to any output via the << operator.
 